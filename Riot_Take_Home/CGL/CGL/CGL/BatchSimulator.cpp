@@ -0,0 +1,167 @@
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "BatchSimulator.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="generations">:generations to simulate per pattern</param>
+/// <param name="numThreads">:worker threads, 0 for hardware concurrency</param>
+BatchSimulator::BatchSimulator(size_t generations, size_t numThreads) : m_generations(generations), m_numThreads(numThreads)
+{
+	if (m_numThreads == 0)
+		m_numThreads = std::thread::hardware_concurrency();
+	if (m_numThreads == 0)
+		m_numThreads = 1;
+	for (size_t i = 0; i < m_numThreads; ++i)
+		m_workers.emplace_back(new Worker());
+}
+
+/// <summary>
+/// Hash all live cells
+/// </summary>
+/// <param name="board"></param>
+void BatchSimulator::HashTracker::Reset(Board& board)
+{
+	m_sum = 0;
+	board.ForEach([this](int64_t row, int64_t col)
+	{
+		m_sum += BoardState::HashCell(row, col);
+		return true;
+	});
+}
+
+/// <summary>
+/// Add the cells about to be born and remove the cells about to die
+/// </summary>
+/// <param name="board"></param>
+/// <param name="toggled"></param>
+void BatchSimulator::HashTracker::OnApplyStarted(Board& board, BoardState& toggled)
+{
+	toggled.ForEach([this, &board](int64_t row, int64_t col)
+	{
+		if (board.IsAlive(row, col))
+			m_sum -= BoardState::HashCell(row, col);
+		else
+			m_sum += BoardState::HashCell(row, col);
+		return true;
+	});
+}
+
+/// <summary>
+/// Check that the worker's board equals the board of an earlier generation with
+/// the same hash, by stepping the pattern to that generation on a second board
+/// </summary>
+/// <param name="worker"></param>
+/// <param name="pattern"></param>
+/// <param name="generation">:earlier generation</param>
+/// <returns>false for a hash collision</returns>
+bool BatchSimulator::Repeats(Worker& worker, const Pattern& pattern, size_t generation)
+{
+	Board& check = worker.m_check;
+	check.Clear();
+	for (const auto& cell : pattern)
+		check.Initialize(cell.m_row, cell.m_col);
+	for (size_t gen = 0; gen < generation; ++gen)
+		check.Accept(&worker.m_checkUpdater);
+
+	if (check.Size() != worker.m_board.Size())
+		return false;
+	bool same = true;
+	check.ForEach([&worker, &same](int64_t row, int64_t col)
+	{
+		same = worker.m_board.IsAlive(row, col);
+		return same;
+	});
+	return same;
+}
+
+/// <summary>
+/// Simulate one pattern on a worker's board and fill in its result
+/// </summary>
+/// <param name="worker"></param>
+/// <param name="pattern"></param>
+/// <param name="result"></param>
+void BatchSimulator::Simulate(Worker& worker, const Pattern& pattern, Result& result)
+{
+	Board& board = worker.m_board;
+	board.Clear();
+	worker.m_seen.clear();
+	for (const auto& cell : pattern)
+		board.Initialize(cell.m_row, cell.m_col);
+
+	result = Result();
+	worker.m_hash.Reset(board);
+	worker.m_seen[worker.m_hash.Hash(board)] = 0;
+	for (size_t gen = 1; gen <= m_generations; ++gen)
+	{
+		board.Accept(&worker.m_updater);
+		if (result.m_period != 0)
+			continue;
+
+		auto inserted = worker.m_seen.emplace(worker.m_hash.Hash(board), gen);
+		if (inserted.second)
+			continue;
+		if (Repeats(worker, pattern, inserted.first->second))
+		{
+			// Once a cycle is found the remaining generations only need stepping
+			result.m_periodStart = inserted.first->second;
+			result.m_period = gen - inserted.first->second;
+		}
+		else
+		{
+			inserted.first->second = gen;	// Collision, keep looking from the newer board
+		}
+	}
+
+	result.m_population = board.Size();
+	result.m_empty = !board.GetBounds(result.m_top, result.m_left, result.m_bottom, result.m_right);
+}
+
+/// <summary>
+/// Simulate all patterns across the worker threads
+/// </summary>
+/// <param name="patterns"></param>
+/// <returns>one result per pattern</returns>
+std::vector<BatchSimulator::Result> BatchSimulator::Run(const std::vector<Pattern>& patterns)
+{
+	std::vector<Result> results(patterns.size());
+	std::atomic<size_t> next(0);
+	std::exception_ptr error;
+	std::mutex errorLock;
+
+	auto work = [&](Worker& worker)
+	{
+		try
+		{
+			for (size_t i = next++; i < patterns.size(); i = next++)
+				Simulate(worker, patterns[i], results[i]);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(errorLock);
+			if (!error)
+				error = std::current_exception();
+			next = patterns.size();
+		}
+	};
+
+	size_t numThreads = std::min(m_numThreads, patterns.size());
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < numThreads; ++t)
+		threads.emplace_back(work, std::ref(*m_workers[t]));
+	if (numThreads > 0)
+		work(*m_workers[0]);
+	for (auto& t : threads)
+		t.join();
+
+	if (error)
+		std::rethrow_exception(error);
+	return results;
+}
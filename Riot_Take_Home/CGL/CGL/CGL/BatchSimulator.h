@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "BoardUpdater.h"
+#include "LifeIO.h"
+
+/// <summary>
+/// Simulates many independent patterns concurrently. Each worker thread owns a
+/// Board and BoardUpdater that are reused for every pattern it picks up, so per
+/// pattern cost is only the simulation itself.
+/// </summary>
+class BatchSimulator
+{
+	public:
+
+		/// <summary>
+		/// Outcome of one simulated pattern
+		/// </summary>
+		struct Result
+		{
+			size_t m_population = 0;
+			size_t m_period = 0;		// 0 if no repetition was seen within the simulated generations
+			size_t m_periodStart = 0;	// First generation of the detected cycle
+			bool m_empty = true;		// No live cells, bounding box is not valid
+			int64_t m_top = 0;
+			int64_t m_left = 0;
+			int64_t m_bottom = 0;
+			int64_t m_right = 0;
+		};
+
+	private:
+
+		/// <summary>
+		/// Keeps the board hash up to date from the toggles of every generation,
+		/// the same value as Board::Hash without walking the board
+		/// </summary>
+		class HashTracker : public Board::ToggleObserver
+		{
+			private:
+
+				uint64_t m_sum = 0;		// Sum of BoardState::HashCell of the live cells
+
+			public:
+
+				// Hash all cells of the board, call before the first update
+				void Reset(Board& board);
+
+				void OnApplyStarted(Board& board, BoardState& toggled) override;
+
+				inline uint64_t Hash(Board& board) const
+				{
+					return m_sum ^ static_cast<uint64_t>(board.Size());
+				}
+		};
+
+		/// <summary>
+		/// Reusable per thread simulation state
+		/// </summary>
+		struct Worker
+		{
+			Board m_board;
+			BoardUpdater m_updater;
+			HashTracker m_hash;
+			std::unordered_map<uint64_t, size_t> m_seen;	// board hash -> generation
+			// Replays the pattern to confirm a repeated hash is a repeated board
+			Board m_check;
+			BoardUpdater m_checkUpdater;
+
+			Worker()
+			{
+				m_board.AddToggleObserver(&m_hash);
+			}
+		};
+
+		size_t m_generations = 0;
+		size_t m_numThreads = 0;
+		std::vector<std::unique_ptr<Worker>> m_workers;
+
+		void Simulate(Worker& worker, const Pattern& pattern, Result& result);
+		bool Repeats(Worker& worker, const Pattern& pattern, size_t generation);
+
+	public:
+
+		// numThreads of 0 uses all available hardware threads
+		BatchSimulator(size_t generations, size_t numThreads = 0);
+
+		inline size_t NumThreads() const
+		{
+			return m_numThreads;
+		}
+
+		// Simulate all patterns, results are in the same order as the patterns
+		std::vector<Result> Run(const std::vector<Pattern>& patterns);
+};
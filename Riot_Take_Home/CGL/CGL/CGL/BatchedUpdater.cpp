@@ -0,0 +1,161 @@
+
+#include <algorithm>
+#include <cstdint>
+
+#include "BatchedUpdater.h"
+
+// Neighbourhood offsets, the cell itself first
+static const int DELTA_ROW[] = { 0, -1, -1, -1, 0, 0, 1, 1, 1 };
+static const int DELTA_COL[] = { 0, -1, 0, 1, -1, 1, -1, 0, 1 };
+
+/// <summary>
+/// Called on visit start
+/// </summary>
+/// <param name="board"></param>
+void BatchedUpdater::OnStarted(Board& board)
+{
+	m_live.clear();
+	m_live.reserve(board.Size());
+}
+
+/// <summary>
+/// Call back function called for each alive cell during visit of board.
+/// </summary>
+/// <param name="board"></param>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns></returns>
+bool BatchedUpdater::Visit(Board& board, int64_t row, int64_t col)
+{
+	m_live.push_back(BoardState::Cell(row, col));
+	return true;
+}
+
+/// <summary>
+/// Fill the block scratch with the addresses and hashes of the 9 cells around
+/// each of count cells. Entry n * count + i is neighbour n of cell i.
+/// </summary>
+/// <param name="cells"></param>
+/// <param name="count">:at most BLOCK_SIZE</param>
+/// <returns>number of keys filled</returns>
+size_t BatchedUpdater::HashNeighbourhoods(const BoardState::Cell* cells, size_t count)
+{
+	for (size_t n = 0; n < NEIGHBOURHOOD; ++n)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			size_t k = n * count + i;
+			int64_t row = cells[i].m_row, col = cells[i].m_col;
+			// Out of range neighbours do not exist, same as BoardUpdater::GetNeighbourhood
+			m_valid[k] = !((DELTA_ROW[n] < 0 && row == MIN) || (DELTA_ROW[n] > 0 && row == MAX)
+				|| (DELTA_COL[n] < 0 && col == MIN) || (DELTA_COL[n] > 0 && col == MAX));
+			m_rows[k] = static_cast<int64_t>(static_cast<uint64_t>(row) + DELTA_ROW[n]);
+			m_cols[k] = static_cast<int64_t>(static_cast<uint64_t>(col) + DELTA_COL[n]);
+		}
+	}
+	size_t keys = count * NEIGHBOURHOOD;
+	FlatCellSet::HashBatch(m_rows, m_cols, m_hashes, keys);
+	return keys;
+}
+
+/// <summary>
+/// Build the live cell set and the de-duplicated list of cells that may change:
+/// every live cell and every in range neighbour of one.
+/// </summary>
+void BatchedUpdater::CollectCandidates()
+{
+	m_liveSet.Clear(m_live.size());
+	m_candidateSet.Clear(m_live.size() * NEIGHBOURHOOD);
+	m_candidates.clear();
+
+	for (size_t start = 0; start < m_live.size(); start += BLOCK_SIZE)
+	{
+		size_t count = std::min(BLOCK_SIZE, m_live.size() - start);
+		const BoardState::Cell* cells = &m_live[start];
+
+		size_t keys = HashNeighbourhoods(cells, count);
+
+		// Row 0 of the block holds the live cells themselves
+		for (size_t i = 0; i < count; ++i)
+			m_liveSet.Insert(m_hashes[i], m_rows[i], m_cols[i]);
+		for (size_t k = 0; k < keys; ++k)
+		{
+			if (m_valid[k] && m_candidateSet.Insert(m_hashes[k], m_rows[k], m_cols[k]))
+				m_candidates.push_back(BoardState::Cell(m_rows[k], m_cols[k]));
+		}
+	}
+}
+
+/// <summary>
+/// Count live neighbours for a block of candidates and queue their state changes
+/// </summary>
+/// <param name="board"></param>
+/// <param name="cells"></param>
+/// <param name="count"></param>
+void BatchedUpdater::EvaluateBlock(Board& board, const BoardState::Cell* cells, size_t count)
+{
+	size_t keys = HashNeighbourhoods(cells, count);
+
+	// Issue every load of the block before the first probe needs one
+	for (size_t k = 0; k < keys; ++k)
+		m_liveSet.Prefetch(m_hashes[k]);
+
+	int counts[BLOCK_SIZE] = {};
+	bool alive[BLOCK_SIZE] = {};
+	for (size_t i = 0; i < count; ++i)
+		alive[i] = m_liveSet.Contains(m_hashes[i], m_rows[i], m_cols[i]);
+	for (size_t k = count; k < keys; ++k)
+	{
+		if (m_valid[k] && m_liveSet.Contains(m_hashes[k], m_rows[k], m_cols[k]))
+			++counts[k % count];
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (alive[i] ? (counts[i] < 2 || counts[i] > 3) : counts[i] == 3)
+			board.QueueToggle(cells[i].m_row, cells[i].m_col);
+	}
+}
+
+/// <summary>
+/// Called on visit ended. All live cells are known, evaluate and apply.
+/// </summary>
+/// <param name="board"></param>
+void BatchedUpdater::OnEnded(Board& board)
+{
+	CollectCandidates();
+	for (size_t start = 0; start < m_candidates.size(); start += BLOCK_SIZE)
+	{
+		size_t count = std::min(BLOCK_SIZE, m_candidates.size() - start);
+		EvaluateBlock(board, &m_candidates[start], count);
+	}
+
+	// Apply any pending cell state changes
+	board.ApplyToggles();
+	m_live.clear();
+}
+
+/// <summary>
+/// Add cell lists and hash sets to a memory report
+/// </summary>
+/// <param name="report"></param>
+void BatchedUpdater::ReportMemory(MemoryReport& report) const
+{
+	MemoryUsage lists;
+	lists.AddBlocks(1, m_live.capacity() * sizeof(BoardState::Cell), m_live.size() * sizeof(BoardState::Cell));
+	lists.AddBlocks(1, m_candidates.capacity() * sizeof(BoardState::Cell), m_candidates.size() * sizeof(BoardState::Cell));
+	report.Add("batched cell lists", lists);
+	report.Add("batched live set", m_liveSet.GetMemoryUsage());
+	report.Add("batched candidate set", m_candidateSet.GetMemoryUsage());
+}
+
+/// <summary>
+/// All scratch is rebuilt on the next update
+/// </summary>
+void BatchedUpdater::ReleaseMemory()
+{
+	std::vector<BoardState::Cell>().swap(m_live);
+	std::vector<BoardState::Cell>().swap(m_candidates);
+	m_liveSet.Release();
+	m_candidateSet.Release();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "Board.h"
+#include "FlatCellSet.h"
+
+/// <summary>
+/// BatchedUpdater - visitor used to update the game of life, alternative to
+/// BoardUpdater for large sparse boards.
+/// Live cells are collected in to a flat hash set, then candidate cells (live
+/// cells and their neighbours) are evaluated in fixed size blocks: the keys of
+/// all 9 cells around every candidate in a block are hashed together, their
+/// slots prefetched, and only then probed.
+/// </summary>
+class BatchedUpdater final : public Board::StaticVisitor<BatchedUpdater>
+{
+	const static int64_t MAX = std::numeric_limits<int64_t>::max();
+	const static int64_t MIN = std::numeric_limits<int64_t>::min();
+	const static size_t BLOCK_SIZE = 16;
+	const static size_t NEIGHBOURHOOD = 9;	// Cell itself and its 8 neighbours
+	const static size_t KEYS_PER_BLOCK = BLOCK_SIZE * NEIGHBOURHOOD;
+
+	std::vector<BoardState::Cell> m_live;
+	std::vector<BoardState::Cell> m_candidates;
+	FlatCellSet m_liveSet;
+	FlatCellSet m_candidateSet;
+
+	// Per block scratch, laid out as [neighbour][candidate] for the hash kernel
+	int64_t m_rows[KEYS_PER_BLOCK];
+	int64_t m_cols[KEYS_PER_BLOCK];
+	bool m_valid[KEYS_PER_BLOCK];
+	uint64_t m_hashes[KEYS_PER_BLOCK];
+
+	size_t HashNeighbourhoods(const BoardState::Cell* cells, size_t count);
+	void CollectCandidates();
+	void EvaluateBlock(Board& board, const BoardState::Cell* cells, size_t count);
+
+public:
+
+	BatchedUpdater() {}
+	virtual ~BatchedUpdater() {}
+
+	void OnStarted(Board& board) override;
+	bool Visit(Board& board, int64_t row, int64_t col) override;
+	void OnEnded(Board& board) override;
+	void ReportMemory(MemoryReport& report) const override;
+	void ReleaseMemory() override;
+};
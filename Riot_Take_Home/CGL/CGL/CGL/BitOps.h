@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Bit scan helpers for 64 bit words of cells
+
+/// <summary>
+/// Index of the lowest set bit, bits cannot be 0
+/// </summary>
+/// <param name="bits"></param>
+/// <returns></returns>
+inline int LowestBit(uint64_t bits)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return static_cast<int>(index);
+#elif defined(__GNUC__)
+	return __builtin_ctzll(bits);
+#else
+	int index = 0;
+	while (!((bits >> index) & 1))
+		++index;
+	return index;
+#endif
+}
+
+/// <summary>
+/// Number of set bits
+/// </summary>
+/// <param name="bits"></param>
+/// <returns></returns>
+inline size_t PopCount(uint64_t bits)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	return static_cast<size_t>(__popcnt64(bits));
+#elif defined(__GNUC__)
+	return static_cast<size_t>(__builtin_popcountll(bits));
+#else
+	size_t count = 0;
+	for (; bits != 0; bits &= bits - 1)
+		++count;
+	return count;
+#endif
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Rule masks: bit n set if a cell with n live neighbours is born / survives
+const uint32_t CONWAY_BIRTH = 1u << 3;
+const uint32_t CONWAY_SURVIVE = (1u << 2) | (1u << 3);
+
+/// <summary>
+/// Lookup table from a 4x4 block of cells to the next state of its centre
+/// 2x2 cells, built at compile time for a life-like rule.
+/// Block bit 4 * r + c is the cell at row r, column c. Result bit 2 * r + c
+/// is the next state of block cell (r + 1, c + 1).
+/// </summary>
+template <uint32_t BIRTH, uint32_t SURVIVE>
+class BlockTable
+{
+	public:
+
+		static const size_t SIZE = 1 << 16;
+
+	private:
+
+		// Next state of the centre of a 3x3 window, bit 3 * r + c is the cell at row r, column c
+		static constexpr std::array<uint8_t, 512> BuildWindows()
+		{
+			std::array<uint8_t, 512> windows = {};
+			for (uint32_t window = 0; window < 512; ++window)
+			{
+				int alive = 0;
+				for (int bit = 0; bit < 9; ++bit)
+					if (bit != 4 && (window >> bit & 1))
+						++alive;
+				uint32_t mask = (window >> 4 & 1) ? SURVIVE : BIRTH;
+				windows[window] = (uint8_t)(mask >> alive & 1);
+			}
+			return windows;
+		}
+
+		// The 3x3 window of a 4x4 block with its top left corner at (r, c)
+		static constexpr uint32_t Window(uint32_t block, int r, int c)
+		{
+			return (block >> (4 * r + c) & 7) | (block >> (4 * r + c + 4) & 7) << 3 | (block >> (4 * r + c + 8) & 7) << 6;
+		}
+
+		static constexpr std::array<uint8_t, SIZE> Build()
+		{
+			const std::array<uint8_t, 512> windows = BuildWindows();
+			std::array<uint8_t, SIZE> table = {};
+			for (uint32_t block = 0; block < SIZE; ++block)
+			{
+				table[block] = (uint8_t)(windows[Window(block, 0, 0)] | windows[Window(block, 0, 1)] << 1
+					| windows[Window(block, 1, 0)] << 2 | windows[Window(block, 1, 1)] << 3);
+			}
+			return table;
+		}
+
+	public:
+
+		static constexpr std::array<uint8_t, SIZE> TABLE = Build();
+};
@@ -1,54 +1,37 @@
 
+#include <algorithm>
 #include <cstdint>
 #include <stdexcept>
 
 #include "Board.h"
 
 /// <summary>
-/// ctor
+/// Copy ctor, shares the state of other
 /// </summary>
-/// <param name="b"></param>
-/// <param name="v"></param>
-Board::BoardVisitor::BoardVisitor(Board* b, Board::Visitor* v) : m_board(b), m_visitor(v)
+/// <param name="other"></param>
+Board::Board(const Board& other) : m_curState(other.m_curState), m_toggled(other.m_toggled)
 {
-	if (b == nullptr)
-		throw std::invalid_argument("board ptr cannot be null");
-	if (v == nullptr)
-		throw std::invalid_argument("visitor ptr cannot be null");
 }
 
 /// <summary>
-/// Calls the encapsulated visitor for visited cell
+/// Copy assignment, shares the state of other and keeps this board's observers
 /// </summary>
-/// <param name="row"></param>
-/// <param name="col"></param>
-/// <returns></returns>
-bool Board::BoardVisitor::Visit(int64_t row, int64_t col)
-{
-	return m_visitor->Visit(*m_board, row, col);
-}
-
-/// <summary>
-/// Toggle visitor : Toggles the cur state of the visited cell 
-/// </summary>
-/// <param name="board"></param>
-/// <param name="row"></param>
-/// <param name="col"></param>
+/// <param name="other"></param>
 /// <returns></returns>
-bool Board::ToggleVisitor::Visit(Board& board, int64_t row, int64_t col)
+Board& Board::operator=(const Board& other)
 {
-	board.m_curState.Toggle(row, col);
-	return true;
+	m_curState = other.m_curState;
+	m_toggled = other.m_toggled;
+	return *this;
 }
 
 /// <summary>
-/// End of toggle visit
+/// Default traversal, one virtual Visit call per cell
 /// </summary>
 /// <param name="board"></param>
-void Board::ToggleVisitor::OnEnded(Board& board)
+void Board::Visitor::Traverse(Board& board)
 {
-	// clear all pending toggles
-	board.m_toggled.Clear();
+	board.Accept(*this);
 }
 
 /// <summary>
@@ -66,8 +49,37 @@ void Board::QueueToggle(int64_t row, int64_t col)
 /// </summary>
 void Board::ApplyToggles()
 {
-	ToggleVisitor tv;
-	Accept(*this, m_toggled, &tv);
+	for (ToggleObserver* observer : m_observers)
+		observer->OnApplyStarted(*this, m_toggled);
+	m_toggled.ForEach([this](int64_t row, int64_t col)
+	{
+		m_curState.Toggle(row, col);
+		return true;
+	});
+	m_toggled.Clear();
+	for (ToggleObserver* observer : m_observers)
+		observer->OnApplyEnded(*this);
+}
+
+/// <summary>
+/// Register an observer of toggle application
+/// </summary>
+/// <param name="observer"></param>
+void Board::AddToggleObserver(ToggleObserver* observer)
+{
+	if (observer == nullptr)
+		throw std::invalid_argument("observer cannot be null");
+	if (std::find(m_observers.begin(), m_observers.end(), observer) == m_observers.end())
+		m_observers.push_back(observer);
+}
+
+/// <summary>
+/// Unregister an observer
+/// </summary>
+/// <param name="observer"></param>
+void Board::RemoveToggleObserver(ToggleObserver* observer)
+{
+	m_observers.erase(std::remove(m_observers.begin(), m_observers.end(), observer), m_observers.end());
 }
 
 /// <summary>
@@ -91,29 +103,32 @@ bool Board::IsAlive(int64_t row, int64_t col)
 	return m_curState.IsSet(row, col);
 }
 
+/// <summary>
+/// Add current state and pending toggles to a memory report
+/// </summary>
+/// <param name="report"></param>
+void Board::ReportMemory(MemoryReport& report) const
+{
+	m_curState.ReportMemory(report, "board");
+	m_toggled.ReportMemory(report, "toggled");
+}
 
 /// <summary>
-/// Accept a visitor
+/// Compact current state, pending toggles are only held during an update
 /// </summary>
-/// <param name="visitor"></param>
-void Board::Accept(Visitor* visitor)
+void Board::Compact()
 {
-	Accept(*this, m_curState, visitor);
+	m_curState.Compact();
+	m_toggled.Compact();
 }
 
 /// <summary>
-/// Helper function to accept a visitor for a given board state
+/// Accept a visitor
 /// </summary>
-/// <param name="board"></param>
-/// <param name="bs"></param>
 /// <param name="visitor"></param>
-void Board::Accept(Board& board, BoardState& bs, Visitor* visitor)
+void Board::Accept(Visitor* visitor)
 {
 	if (visitor == nullptr)
 		throw std::invalid_argument("visitor cannot be null");
-	BoardVisitor bv(&board, visitor);
-	visitor->OnStarted(board);
-	bs.Accept(&bv);
-	visitor->OnEnded(board);
+	visitor->Traverse(*this);
 }
-
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <assert.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include "BoardState.h"
 
 /// <summary>
@@ -20,55 +24,78 @@ class Board
 				virtual void OnStarted(Board& board) {}
 				virtual void OnEnded(Board& board) {}
 				virtual bool Visit(Board& board, int64_t row, int64_t col) = 0;
+				// Walk the board's cells. The default calls Visit virtually, StaticVisitor overrides it with an inlined walk
+				virtual void Traverse(Board& board);
+				// Add the visitor's own structures to a memory report
+				virtual void ReportMemory(MemoryReport& report) const {}
+				// Drop memory that can be rebuilt on the next visit
+				virtual void ReleaseMemory() {}
 				virtual ~Visitor() {}
 
 		};
 
-
-	private:
-
 		/// <summary>
-		/// Board state visitor. Enacapsulates board and Board::Visitor
+		/// CRTP visitor base. Derived::Visit is called directly, so a visit through
+		/// a Visitor pointer costs one virtual call per traversal, not per cell.
+		/// Declare Derived final, otherwise Visit stays a virtual call per cell
 		/// </summary>
-		class BoardVisitor : public BoardState::Visitor
+		template <typename Derived>
+		class StaticVisitor : public Visitor
 		{
-			private:
-				
-				Board* m_board = nullptr;
-				Board::Visitor* m_visitor = nullptr;
-
 			public:
-
-				BoardVisitor(Board* b, Board::Visitor* v);
-
-				virtual bool Visit(int64_t row, int64_t col);
+				void Traverse(Board& board) override
+				{
+					board.Accept(static_cast<Derived&>(*this));
+				}
 		};
 
 		/// <summary>
-		/// State toggle visitor. Applies the pending toggles
+		/// Observer base, notified around every application of pending toggles
 		/// </summary>
-		class ToggleVisitor : public Visitor
+		class ToggleObserver
 		{
-			friend class Board;
-
 			public:
-
-				virtual bool Visit(Board& board, int64_t row, int64_t col);
-				virtual void OnEnded(Board& board);
+				ToggleObserver() {}
+				// Before toggles are applied: a cell in toggled is born if board has it dead, else it dies
+				virtual void OnApplyStarted(Board& board, BoardState& toggled) {}
+				// After all toggles were applied
+				virtual void OnApplyEnded(Board& board) {}
+				virtual ~ToggleObserver() {}
 		};
 
+
+	private:
+
 		BoardState m_curState;
 		BoardState m_toggled;	// Contains only cells whose state is pending toggle in m_curState
-
-		static void Accept(Board& board, BoardState& bs, Visitor* visitor);
+		std::vector<ToggleObserver*> m_observers;
 
 	public:
 
 		Board() {}
+		// Copies share the cells of other until either board changes them. Observers are not copied
+		Board(const Board& other);
+		Board& operator=(const Board& other);
+
+		// O(1) copy of this board, later changes to either only copy the touched parts
+		inline Board Fork() const
+		{
+			return Board(*this);
+		}
 
 		inline size_t Size()
 		{
-			m_curState.Size();
+			return m_curState.Size();
+		}
+
+		inline uint64_t Hash()
+		{
+			return m_curState.Hash();
+		}
+
+		inline bool GetBounds(int64_t& top, int64_t& left, int64_t& bottom, int64_t& right)
+		{
+			return m_curState.GetBounds(top, left, bottom, right);
 		}
 
 		inline void Clear()
@@ -77,10 +104,29 @@ class Board
 			m_toggled.Clear();
 		}
 
+		// Add the board's structures to a memory report
+		void ReportMemory(MemoryReport& report) const;
+		// Rebuild the board's structures in fresh allocations
+		void Compact();
+
+		// Keep the current state in a memory mapped file instead of the heap, with at most residentBytes mapped in
+		inline void UsePagedStorage(const std::string& path, size_t residentBytes = 0)
+		{
+			m_curState.UsePagedStorage(path, residentBytes);
+		}
+
+		inline bool IsPaged() const
+		{
+			return m_curState.IsPaged();
+		}
+
 		// Add a pending toggle for cur state
 		void QueueToggle(int64_t row, int64_t col);
 		// Apply all pending toggle for cur state
 		void ApplyToggles();
+		// Observers are not owned and must outlive their registration
+		void AddToggleObserver(ToggleObserver* observer);
+		void RemoveToggleObserver(ToggleObserver* observer);
 		// Initialize a cell address to alive
 		void Initialize(int64_t row, int64_t col);
 
@@ -88,5 +134,40 @@ class Board
 
 		// Accept a visitor
 		void Accept(Visitor* visitor);
+
+		/// <summary>
+		/// Accept a visitor of a known type. Its Visit is called without virtual
+		/// dispatch if V is final, so the traversal and Visit compile to one loop.
+		/// A V that is not final may be a base of the actual visitor, its Visit is called virtually
+		/// </summary>
+		/// <param name="visitor"></param>
+		template <typename V, typename = typename std::enable_if<std::is_base_of<Visitor, V>::value>::type>
+		void Accept(V& visitor)
+		{
+			visitor.OnStarted(*this);
+			m_curState.ForEach([this, &visitor](int64_t row, int64_t col)
+			{
+				if constexpr (std::is_final<V>::value)
+					return visitor.V::Visit(*this, row, col);
+				else
+					return visitor.Visit(*this, row, col);
+			});
+			visitor.OnEnded(*this);
+		}
+
+		// Call f(row, col) for every live cell until it returns false
+		template <typename F>
+		inline void ForEach(F&& f)
+		{
+			m_curState.ForEach(std::forward<F>(f));
+		}
+
+		// Call f(row, col) for every live cell inside the box until it returns false,
+		// walking only the rows and columns of the box
+		template <typename F>
+		inline void ForEachIn(int64_t top, int64_t left, int64_t bottom, int64_t right, F&& f)
+		{
+			m_curState.ForEachIn(top, left, bottom, right, std::forward<F>(f));
+		}
 };
 
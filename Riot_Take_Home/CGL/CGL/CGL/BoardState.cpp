@@ -1,31 +1,96 @@
 #include <stdexcept>
 
 #include "BoardState.h"
+#include "TilePageStore.h"
+
+namespace
+{
+	/// <summary>
+	/// Move a set's values in to fresh nodes, freeing each old node right after
+	/// its copy. A node shared with another state is copied and left alone
+	/// </summary>
+	template <typename Set>
+	void CompactSet(std::shared_ptr<Set>& node)
+	{
+		std::shared_ptr<Set> fresh = std::make_shared<Set>();
+		bool owned = node.use_count() == 1;
+		for (auto it = node->begin(); it != node->end(); )
+		{
+			fresh->insert(fresh->end(), *it);
+			it = owned ? node->erase(it) : std::next(it);
+		}
+		node.swap(fresh);
+	}
+
+	/// <summary>
+	/// Move a map level in to fresh nodes like CompactSet, compacting every child as it is moved
+	/// </summary>
+	template <typename Map, typename F>
+	void CompactMap(std::shared_ptr<Map>& node, F compactChild)
+	{
+		std::shared_ptr<Map> fresh = std::make_shared<Map>();
+		bool owned = node.use_count() == 1;
+		for (auto it = node->begin(); it != node->end(); )
+		{
+			auto added = owned ? fresh->emplace_hint(fresh->end(), it->first, std::move(it->second))
+				: fresh->emplace_hint(fresh->end(), it->first, it->second);
+			compactChild(added->second);
+			it = owned ? node->erase(it) : std::next(it);
+		}
+		node.swap(fresh);
+	}
+}
+
+/// <summary>
+/// ctor
+/// </summary>
+BoardState::BoardState()
+{
+}
+
+/// <summary>
+/// Copy ctor. Shares all map levels with other, each side copies a node only when it first changes it
+/// </summary>
+/// <param name="other"></param>
+BoardState::BoardState(const BoardState& other) : m_r0_map(other.m_r0_map), m_size(other.m_size)
+{
+	if (other.m_pages)
+		throw std::runtime_error("A paged board state can not be shared");
+}
+
+/// <summary>
+/// Copy assignment, shares all map levels with other
+/// </summary>
+/// <param name="other"></param>
+/// <returns></returns>
+BoardState& BoardState::operator=(const BoardState& other)
+{
+	if (other.m_pages || m_pages)
+		throw std::runtime_error("A paged board state can not be shared");
+	m_r0_map = other.m_r0_map;
+	m_size = other.m_size;
+	return *this;
+}
 
 /// <summary>
-/// Helper function to unpack a 64 bit int to two 32 bits ints
+/// dtor
 /// </summary>
-/// <param name="in"></param>
-/// <param name="w0"></param>
-/// <param name="w1"></param>
-void BoardState::UnPack64(int64_t in, uint32_t& w0, uint32_t& w1)
+BoardState::~BoardState()
 {
-	uint64_t uin = *(reinterpret_cast<uint64_t*>(&in));
-	w1 = (uint32_t)(uin & 0xFFFFFFFFLL);
-	w0 = (uint32_t)((uin & 0xFFFFFFFF00000000LL) >> 32);
 }
 
 /// <summary>
-/// Helper function to pack two 32 bits ints in to one 64 bit int
+/// Hash of a single cell (splitmix64 finalizer over both coordinates)
 /// </summary>
-/// <param name="w0"></param>
-/// <param name="w1"></param>
+/// <param name="row"></param>
+/// <param name="col"></param>
 /// <returns></returns>
-int64_t BoardState::Pack64(uint32_t w0, uint32_t w1)
+uint64_t BoardState::HashCell(int64_t row, int64_t col)
 {
-	uint64_t u = (static_cast<uint64_t>(w0)) << 32 | (static_cast<uint64_t>(w1));
-	int64_t i = *(reinterpret_cast<int64_t*>(&u));
-	return i;
+	uint64_t h = static_cast<uint64_t>(row) * 0x9E3779B97F4A7C15ULL ^ static_cast<uint64_t>(col);
+	h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+	return h ^ (h >> 31);
 }
 
 /// <summary>
@@ -35,15 +100,18 @@ int64_t BoardState::Pack64(uint32_t w0, uint32_t w1)
 /// <param name="col"></param>
 void BoardState::Set(int64_t row, int64_t col)
 {
+	if (m_pages)
+	{
+		m_pages->Set(row, col);
+		return;
+	}
+
 	uint32_t r0, r1, c0, c1;
 	UnPack64(row, r0, r1);
 	UnPack64(col, c0, c1);
-	INT32_0& set = m_r0_map[r0][r1][c0];
-	if (set.find(c1) == set.end())
-	{
+	INT32_0& set = Own(Own(Own(Own(m_r0_map)[r0])[r1])[c0]);
+	if (set.insert(c1).second)
 		++m_size;
-		set.insert(c1);
-	}
 }
 
 /// <summary>
@@ -52,7 +120,18 @@ void BoardState::Set(int64_t row, int64_t col)
 /// <returns></returns>
 size_t BoardState::Size()
 {
-	return m_size;
+	return m_pages ? m_pages->Size() : m_size;
+}
+
+/// <summary>
+/// Remove all cells
+/// </summary>
+void BoardState::Clear()
+{
+	if (m_pages)
+		m_pages->Clear();
+	m_r0_map.reset();
+	m_size = 0;
 }
 
 /// <summary>
@@ -62,46 +141,15 @@ size_t BoardState::Size()
 /// <param name="col"></param>
 void BoardState::Clear(int64_t row, int64_t col)
 {
-	uint32_t r0, r1;
-	UnPack64(row, r0, r1);
-
-	auto r0_it = m_r0_map.find(r0);
-	if (r0_it == m_r0_map.end())
-		return; // no such element
-
-	INT32_2& r1_map = r0_it->second;
-	auto r1_it = r1_map.find(r1);
-	if (r1_it == r1_map.end())
-		return; // no such element
-
-	uint32_t c0, c1;
-	UnPack64(col, c0, c1);
-
-	INT32_1& c0_map = r1_it->second;
-	auto c0_it = c0_map.find(c0);
-	if (c0_it == c0_map.end())
-		return; // no such element
-
-	INT32_0& c1_set = c0_it->second;
-	auto c1_it = c1_set.find(c1);
-	if (c1_it == c1_set.end())
-		return; // no such element
-
-	c1_set.erase(c1_it);
-	--m_size;
-
-	if (c1_set.empty())
+	if (m_pages)
 	{
-		c0_map.erase(c0_it);
-		if (c0_map.empty())
-		{
-			r1_map.erase(r1_it);
-			if (r1_map.empty())
-			{
-				m_r0_map.erase(r0_it);
-			}
-		}
+		m_pages->Clear(row, col);
+		return;
 	}
+
+	// Only a cell that is set changes, so shared nodes are not copied for nothing
+	if (IsSet(row, col))
+		Toggle(row, col);
 }
 
 /// <summary>
@@ -112,14 +160,20 @@ void BoardState::Clear(int64_t row, int64_t col)
 /// <returns></returns>
 bool BoardState::IsSet(int64_t row, int64_t col) const
 {
+	if (m_pages)
+		return m_pages->IsSet(row, col);
+
+	if (!m_r0_map)
+		return false;
+
 	uint32_t r0, r1;
 	UnPack64(row, r0, r1);
 
-	auto r0_it = m_r0_map.find(r0);
-	if (r0_it == m_r0_map.end())
+	auto r0_it = m_r0_map->find(r0);
+	if (r0_it == m_r0_map->end())
 		return false; // no such element
 
-	const INT32_2& r1_map = r0_it->second;
+	const INT32_2& r1_map = *r0_it->second;
 	auto r1_it = r1_map.find(r1);
 	if (r1_it == r1_map.end())
 		return false; // no such element
@@ -127,12 +181,12 @@ bool BoardState::IsSet(int64_t row, int64_t col) const
 	uint32_t c0, c1;
 	UnPack64(col, c0, c1);
 
-	const INT32_1& c0_map = r1_it->second;
+	const INT32_1& c0_map = *r1_it->second;
 	auto c0_it = c0_map.find(c0);
 	if (c0_it == c0_map.end())
 		return false; // no such element
 
-	const INT32_0& c1_set = c0_it->second;
+	const INT32_0& c1_set = *c0_it->second;
 	auto c1_it = c1_set.find(c1);
 	if (c1_it == c1_set.end())
 		return false; // no such element
@@ -147,57 +201,167 @@ bool BoardState::IsSet(int64_t row, int64_t col) const
 /// <param name="col"></param>
 void BoardState::Toggle(int64_t row, int64_t col)
 {
+	if (m_pages)
+	{
+		m_pages->Toggle(row, col);
+		return;
+	}
+
 	uint32_t r0, r1;
 	UnPack64(row, r0, r1);
 	uint32_t c0, c1;
 	UnPack64(col, c0, c1);
 
-	auto r0_it = m_r0_map.find(r0);
-	if (r0_it == m_r0_map.end())
+	// Every level on the path is written, shared nodes are copied on the way down
+	INT32_3& r0_map = Own(m_r0_map);
+	auto r0_it = r0_map.try_emplace(r0).first;
+	INT32_2& r1_map = Own(r0_it->second);
+	auto r1_it = r1_map.try_emplace(r1).first;
+	INT32_1& c0_map = Own(r1_it->second);
+	auto c0_it = c0_map.try_emplace(c0).first;
+	INT32_0& c1_set = Own(c0_it->second);
+
+	auto c1_it = c1_set.insert(c1);
+	if (c1_it.second)
 	{
-		m_r0_map[r0][r1][c0].insert(c1);
+		++m_size;
 		return;
 	}
 
-	INT32_2& r1_map = r0_it->second;
-	auto r1_it = r1_map.find(r1);
-	if (r1_it == r1_map.end())
+	c1_set.erase(c1_it.first);
+	--m_size;
+
+	if (c1_set.empty())
 	{
-		r1_map[r1][c0].insert(c1);
+		c0_map.erase(c0_it);
+		if (c0_map.empty())
+		{
+			r1_map.erase(r1_it);
+			if (r1_map.empty())
+			{
+				r0_map.erase(r0_it);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Estimate memory of every map level by walking the trie
+/// </summary>
+/// <param name="levels">:r0, r1, c0 and c1 levels</param>
+void BoardState::GetMemoryUsage(MemoryUsage (&levels)[LEVELS]) const
+{
+	for (auto& level : levels)
+		level = MemoryUsage();
+
+	if (!m_r0_map)
 		return;
+
+	// Nodes shared with other states are counted in each of them
+	const size_t key = sizeof(uint32_t);
+	const size_t shared = 2 * sizeof(void*);	// Reference counts allocated with each node
+	const INT32_3& r0_map = *m_r0_map;
+	levels[0].AddBlocks(1, sizeof(INT32_3) + shared, 0);
+	levels[0].AddNodes(r0_map.size(), sizeof(INT32_3::value_type), r0_map.size() * key);
+	for (const auto& r0 : r0_map)
+	{
+		const INT32_2& r1_map = *r0.second;
+		levels[1].AddBlocks(1, sizeof(INT32_2) + shared, 0);
+		levels[1].AddNodes(r1_map.size(), sizeof(INT32_2::value_type), r1_map.size() * key);
+		for (const auto& r1 : r1_map)
+		{
+			const INT32_1& c0_map = *r1.second;
+			levels[2].AddBlocks(1, sizeof(INT32_1) + shared, 0);
+			levels[2].AddNodes(c0_map.size(), sizeof(INT32_1::value_type), c0_map.size() * key);
+			for (const auto& c0 : c0_map)
+			{
+				const INT32_0& c1_set = *c0.second;
+				levels[3].AddBlocks(1, sizeof(INT32_0) + shared, 0);
+				levels[3].AddNodes(c1_set.size(), sizeof(INT32_0::value_type), c1_set.size() * key);
+			}
+		}
 	}
+}
 
-	INT32_1& c0_map = r1_it->second;
-	auto c0_it = c0_map.find(c0);
-	if (c0_it == c0_map.end())
+/// <summary>
+/// Add one report entry per map level
+/// </summary>
+/// <param name="report"></param>
+/// <param name="name">:prefix of the entry names</param>
+void BoardState::ReportMemory(MemoryReport& report, const std::string& name) const
+{
+	static const char* LEVEL_NAMES[LEVELS] = { " r0", " r1", " c0", " c1" };
+	if (m_pages)
 	{
-		c0_map[c0].insert(c1);
+		report.Add(name + " paged tiles", m_pages->GetMemoryUsage());
 		return;
 	}
 
-	INT32_0& c1_set = c0_it->second;
-	auto c1_it = c1_set.find(c1);
-	if (c1_it == c1_set.end())
+	MemoryUsage levels[LEVELS];
+	GetMemoryUsage(levels);
+	for (size_t i = 0; i < LEVELS; ++i)
+		report.Add(name + LEVEL_NAMES[i], levels[i]);
+}
+
+/// <summary>
+/// Move all map levels in to new nodes and release the old ones. After long
+/// runs of Toggle the nodes are scattered over the heap, fresh nodes are
+/// allocated in traversal order and let the allocator return the old pages.
+/// Every old node is freed as soon as it was moved, so compacting needs
+/// about one node of extra memory, not a second copy of the board.
+/// The result shares nothing with other states.
+/// </summary>
+void BoardState::Compact()
+{
+	if (m_pages)
 	{
-		c1_set.insert(c1);
+		m_pages->EvictAll();
 		return;
 	}
 
-	c1_set.erase(c1_it);
-	--m_size;
+	if (!m_r0_map)
+		return;
 
-	if (c1_set.empty())
+	CompactMap(m_r0_map, [](std::shared_ptr<INT32_2>& r1_map)
 	{
-		c0_map.erase(c0_it);
-		if (c0_map.empty())
+		CompactMap(r1_map, [](std::shared_ptr<INT32_1>& c0_map)
 		{
-			r1_map.erase(r1_it);
-			if (r1_map.empty())
+			CompactMap(c0_map, [](std::shared_ptr<INT32_0>& c1_set) { CompactSet(c1_set); });
+		});
+	});
+}
+
+/// <summary>
+/// Switch to file backed tile storage. All current cells are moved to the
+/// tile store and the map levels are released.
+/// </summary>
+/// <param name="path">:scratch file, removed when the state is destroyed</param>
+/// <param name="residentBytes">:memory for mapped in tiles, 0 for the default</param>
+void BoardState::UsePagedStorage(const std::string& path, size_t residentBytes)
+{
+	if (m_pages)
+		return;
+
+	class MoveVisitor : public Visitor
+	{
+		public:
+			TilePageStore* m_store = nullptr;
+
+			virtual bool Visit(int64_t row, int64_t col)
 			{
-				m_r0_map.erase(r0_it);
+				m_store->Set(row, col);
+				return true;
 			}
-		}
-	}
+	};
+
+	std::unique_ptr<TilePageStore> pages(new TilePageStore(path, residentBytes != 0 ? residentBytes : TilePageStore::DEFAULT_RESIDENT_BYTES));
+	MoveVisitor mv;
+	mv.m_store = pages.get();
+	Accept(&mv);
+
+	m_r0_map.reset();
+	m_size = 0;
+	m_pages = std::move(pages);
 }
 
 /// <summary>
@@ -209,25 +373,60 @@ void BoardState::Accept(Visitor* visitor)
 	if (visitor == nullptr)
 		throw std::invalid_argument("visitor cannot be null");
 
-	for (INT32_3::iterator r0_it = m_r0_map.begin(); r0_it != m_r0_map.end(); ++r0_it)
+	ForEach([visitor](int64_t row, int64_t col) { return visitor->Visit(row, col); });
+}
+
+/// <summary>
+/// Paged traversal, through a virtual visitor as the tile store is not visible to the ForEach template
+/// </summary>
+/// <param name="visitor"></param>
+void BoardState::AcceptPaged(Visitor* visitor)
+{
+	m_pages->Accept(visitor);
+}
+
+/// <summary>
+/// Order independent hash of all active cells. Two states with the same cells
+/// hash the same regardless of how they were built.
+/// </summary>
+/// <returns></returns>
+uint64_t BoardState::Hash()
+{
+	uint64_t hash = 0;
+	ForEach([&hash](int64_t row, int64_t col)
+	{
+		hash += HashCell(row, col);
+		return true;
+	});
+	return hash ^ static_cast<uint64_t>(Size());
+}
+
+/// <summary>
+/// Bounding box of all active cells
+/// </summary>
+/// <param name="top"></param>
+/// <param name="left"></param>
+/// <param name="bottom"></param>
+/// <param name="right"></param>
+/// <returns>false if there are no active cells</returns>
+bool BoardState::GetBounds(int64_t& top, int64_t& left, int64_t& bottom, int64_t& right)
+{
+	bool any = false;
+	top = left = bottom = right = 0;
+	ForEach([&](int64_t row, int64_t col)
 	{
-		INT32_2 r1_map = r0_it->second;
-		for (INT32_2::iterator r1_it = r1_map.begin(); r1_it != r1_map.end(); ++r1_it)
+		if (!any)
 		{
-			INT32_1 c0_map = r1_it->second;
-			for (INT32_1::iterator c0_it = c0_map.begin(); c0_it != c0_map.end(); ++c0_it)
-			{
-				INT32_0 c1_set = c0_it->second;
-				for (INT32_0::iterator c1_it = c1_set.begin(); c1_it != c1_set.end(); ++c1_it)
-				{
-					int64_t row = Pack64(r0_it->first, r1_it->first);
-					int64_t col = Pack64(c0_it->first, *c1_it);
-					if (!visitor->Visit(row, col))
-						return;
-				}
-			}
+			top = bottom = row;
+			left = right = col;
+			any = true;
+			return true;
 		}
-	}
+		top = row < top ? row : top;
+		bottom = row > bottom ? row : bottom;
+		left = col < left ? col : left;
+		right = col > right ? col : right;
+		return true;
+	});
+	return any;
 }
-
-
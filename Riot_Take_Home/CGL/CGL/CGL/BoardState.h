@@ -1,10 +1,18 @@
 #pragma once
 
+#include <atomic>
 #include <set>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <cstdint>
+#include <string>
+#include <type_traits>
+
+#include "MemoryUsage.h"
+
+class TilePageStore;
 
 /// <summary>
 /// Container for active cells
@@ -36,31 +44,104 @@ class BoardState
 		// and stored in the following structure.
 		// A address exists in the container if all 4 parts of it can be found by
 		// traversing the maps.
+		// Levels hold their children by shared pointer so copies of a state share
+		// them; a node is copied before it is changed if anyone else holds it.
 
 		typedef std::set<uint32_t> INT32_0;
-		typedef std::map<uint32_t, INT32_0> INT32_1;
-		typedef std::map<uint32_t, INT32_1> INT32_2;
-		typedef std::map<uint32_t, INT32_2> INT32_3;
+		typedef std::map<uint32_t, std::shared_ptr<INT32_0>> INT32_1;
+		typedef std::map<uint32_t, std::shared_ptr<INT32_1>> INT32_2;
+		typedef std::map<uint32_t, std::shared_ptr<INT32_2>> INT32_3;
 
-		INT32_3 m_r0_map;
+		std::shared_ptr<INT32_3> m_r0_map;	// Null when empty
 		size_t m_size = 0;
 
+		// When set all cells live in this file backed store and the maps stay empty
+		std::unique_ptr<TilePageStore> m_pages;
+
 		void Set(int64_t row, int64_t col);
 		void Clear(int64_t row, int64_t col);
+		void AcceptPaged(Visitor* visitor);
+
+		/// <summary>
+		/// Node ready to be changed: created if missing, copied if shared. A copy
+		/// shares the node's children, so only the path to a change is copied
+		/// </summary>
+		/// <param name="node"></param>
+		/// <returns></returns>
+		template <typename T>
+		inline static T& Own(std::shared_ptr<T>& node)
+		{
+			if (!node)
+				node = std::make_shared<T>();
+			else if (node.use_count() > 1)
+				node = std::make_shared<T>(*node);
+			else
+				std::atomic_thread_fence(std::memory_order_acquire);	// Pairs with the release of the last other holder
+			return *node;
+		}
+
+		inline static uint32_t Key(uint32_t key)
+		{
+			return key;
+		}
+
+		template <typename T>
+		inline static uint32_t Key(const std::pair<const uint32_t, T>& entry)
+		{
+			return entry.first;
+		}
+
+		/// <summary>
+		/// Call f on the entries of a map level with keys from lo to hi
+		/// </summary>
+		/// <returns>false if f stopped the walk</returns>
+		template <typename Level, typename F>
+		inline static bool ForRange(const Level& level, uint32_t lo, uint32_t hi, F&& f)
+		{
+			for (auto it = level.lower_bound(lo); it != level.end() && Key(*it) <= hi; ++it)
+			{
+				if (!f(*it))
+					return false;
+			}
+			return true;
+		}
+
+		template <typename F>
+		bool ForEachInRange(uint64_t rowLo, uint64_t rowHi, const uint64_t (&cols)[2][2], size_t numCols, F& f);
+
+		/// <summary>
+		/// Adapts a callable to the virtual visitor interface
+		/// </summary>
+		template <typename F>
+		class FunctionVisitor : public Visitor
+		{
+			private:
+
+				F& m_function;
+
+			public:
+
+				FunctionVisitor(F& f) : m_function(f) {}
+
+				virtual bool Visit(int64_t row, int64_t col)
+				{
+					return m_function(row, col);
+				}
+		};
 
 	public:
 
 		
-		BoardState()	{}
+		BoardState();
+		// Copies are O(1) and share structure until either side changes (not for paged states)
+		BoardState(const BoardState& other);
+		BoardState& operator=(const BoardState& other);
+		~BoardState();
 
 		size_t Size();
 
 		
-		inline void Clear()
-		{
-			m_r0_map.clear();
-			m_size = 0;
-		}
+		void Clear();
 
 		inline void Set(int64_t row, int64_t col, bool aliveStatus)
 		{
@@ -73,12 +154,191 @@ class BoardState
 		bool IsSet(int64_t row, int64_t col) const;
 		void Toggle(int64_t row, int64_t col);
 
+		// Order independent hash of all contained cells
+		uint64_t Hash();
+		// Bounding box of all contained cells, false if empty
+		bool GetBounds(int64_t& top, int64_t& left, int64_t& bottom, int64_t& right);
+
+		// Estimated memory of each map level, index 0 is the r0 (root) level
+		static const size_t LEVELS = 4;
+		void GetMemoryUsage(MemoryUsage (&levels)[LEVELS]) const;
+		void ReportMemory(MemoryReport& report, const std::string& name) const;
+		// Rebuild all map levels in fresh allocations
+		void Compact();
+
+		// Move all cells to a memory mapped tile store backed by a scratch file at path,
+		// keeping at most residentBytes of tiles in memory (0 for the store's default)
+		void UsePagedStorage(const std::string& path, size_t residentBytes = 0);
+		inline bool IsPaged() const
+		{
+			return m_pages != nullptr;
+		}
+
 		// Accept a visitor to visit all contained cells
 		void Accept(Visitor* visitor);
 
+		// Call f(row, col) for all contained cells until it returns false. The
+		// traversal and f compile to one loop without a virtual call per cell
+		template <typename F>
+		void ForEach(F&& f);
+
+		// Call f(row, col) for the contained cells inside a box, in the order of
+		// ForEach, until it returns false. Only the rows and columns in the box
+		// are walked, a paged state is walked in full and filtered
+		template <typename F>
+		void ForEachIn(int64_t top, int64_t left, int64_t bottom, int64_t right, F&& f);
+
 		// Helper functions
-		static void UnPack64(int64_t in, uint32_t& w0, uint32_t& w1);
-		static int64_t Pack64(uint32_t w0, uint32_t w1);
+
+		/// <summary>
+		/// Unpack a 64 bit int to two 32 bits ints
+		/// </summary>
+		/// <param name="in"></param>
+		/// <param name="w0"></param>
+		/// <param name="w1"></param>
+		inline static void UnPack64(int64_t in, uint32_t& w0, uint32_t& w1)
+		{
+			uint64_t uin = static_cast<uint64_t>(in);
+			w1 = (uint32_t)(uin & 0xFFFFFFFFLL);
+			w0 = (uint32_t)((uin & 0xFFFFFFFF00000000LL) >> 32);
+		}
+
+		/// <summary>
+		/// Pack two 32 bits ints in to one 64 bit int
+		/// </summary>
+		/// <param name="w0"></param>
+		/// <param name="w1"></param>
+		/// <returns></returns>
+		inline static int64_t Pack64(uint32_t w0, uint32_t w1)
+		{
+			return static_cast<int64_t>((static_cast<uint64_t>(w0)) << 32 | (static_cast<uint64_t>(w1)));
+		}
+
+		static uint64_t HashCell(int64_t row, int64_t col);
 };
 
+/// <summary>
+/// Visit the contained cells inside a box, looking up the first row and column
+/// of the box on every map level instead of walking all cells
+/// </summary>
+/// <param name="top"></param>
+/// <param name="left"></param>
+/// <param name="bottom"></param>
+/// <param name="right"></param>
+/// <param name="f">:bool(int64_t row, int64_t col), false to stop</param>
+template <typename F>
+void BoardState::ForEachIn(int64_t top, int64_t left, int64_t bottom, int64_t right, F&& f)
+{
+	if (m_pages)
+	{
+		ForEach([&](int64_t row, int64_t col)
+		{
+			if (row < top || row > bottom || col < left || col > right)
+				return true;
+			return f(row, col);
+		});
+		return;
+	}
+	if (!m_r0_map || top > bottom || left > right)
+		return;
 
+	// Keys are ordered as unsigned, a box across 0 is two ranges with the non negative one first
+	uint64_t cols[2][2];
+	size_t numCols = 0;
+	if (left < 0 && right >= 0)
+	{
+		cols[numCols][0] = 0;
+		cols[numCols++][1] = static_cast<uint64_t>(right);
+		cols[numCols][0] = static_cast<uint64_t>(left);
+		cols[numCols++][1] = UINT64_MAX;
+	}
+	else
+	{
+		cols[numCols][0] = static_cast<uint64_t>(left);
+		cols[numCols++][1] = static_cast<uint64_t>(right);
+	}
+
+	if (top < 0 && bottom >= 0)
+	{
+		if (ForEachInRange(0, static_cast<uint64_t>(bottom), cols, numCols, f))
+			ForEachInRange(static_cast<uint64_t>(top), UINT64_MAX, cols, numCols, f);
+	}
+	else
+	{
+		ForEachInRange(static_cast<uint64_t>(top), static_cast<uint64_t>(bottom), cols, numCols, f);
+	}
+}
+
+/// <summary>
+/// Visit the cells in an unsigned row range and up to two unsigned column ranges
+/// </summary>
+/// <param name="rowLo"></param>
+/// <param name="rowHi"></param>
+/// <param name="cols">:low and high of each column range</param>
+/// <param name="numCols"></param>
+/// <param name="f"></param>
+/// <returns>false if f stopped the walk</returns>
+template <typename F>
+bool BoardState::ForEachInRange(uint64_t rowLo, uint64_t rowHi, const uint64_t (&cols)[2][2], size_t numCols, F& f)
+{
+	uint32_t lo0, lo1, hi0, hi1;
+	UnPack64(static_cast<int64_t>(rowLo), lo0, lo1);
+	UnPack64(static_cast<int64_t>(rowHi), hi0, hi1);
+	return ForRange(*m_r0_map, lo0, hi0, [&](const INT32_3::value_type& r0)
+	{
+		return ForRange(*r0.second, r0.first == lo0 ? lo1 : 0, r0.first == hi0 ? hi1 : UINT32_MAX, [&](const INT32_2::value_type& r1)
+		{
+			int64_t row = Pack64(r0.first, r1.first);
+			for (size_t i = 0; i < numCols; ++i)
+			{
+				uint32_t clo0, clo1, chi0, chi1;
+				UnPack64(static_cast<int64_t>(cols[i][0]), clo0, clo1);
+				UnPack64(static_cast<int64_t>(cols[i][1]), chi0, chi1);
+				bool more = ForRange(*r1.second, clo0, chi0, [&](const INT32_1::value_type& c0)
+				{
+					return ForRange(*c0.second, c0.first == clo0 ? clo1 : 0, c0.first == chi0 ? chi1 : UINT32_MAX, [&](uint32_t c1)
+					{
+						return f(row, Pack64(c0.first, c1));
+					});
+				});
+				if (!more)
+					return false;
+			}
+			return true;
+		});
+	});
+}
+
+/// <summary>
+/// Visit all contained cells in order, walking the map levels by reference
+/// </summary>
+/// <param name="f">:bool(int64_t row, int64_t col), false to stop</param>
+template <typename F>
+void BoardState::ForEach(F&& f)
+{
+	if (m_pages)
+	{
+		FunctionVisitor<typename std::remove_reference<F>::type> adapter(f);
+		AcceptPaged(&adapter);
+		return;
+	}
+
+	if (!m_r0_map)
+		return;
+
+	for (const auto& r0 : *m_r0_map)
+	{
+		for (const auto& r1 : *r0.second)
+		{
+			int64_t row = Pack64(r0.first, r1.first);
+			for (const auto& c0 : *r1.second)
+			{
+				for (uint32_t c1 : *c0.second)
+				{
+					if (!f(row, Pack64(c0.first, c1)))
+						return;
+				}
+			}
+		}
+	}
+}
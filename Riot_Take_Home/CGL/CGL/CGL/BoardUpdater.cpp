@@ -26,10 +26,13 @@ void BoardUpdater::UpdateDeadCellStatus(Board& board, int64_t row, int64_t col,
 	int64_t left, top, right, bottom;
 	GetNeighbourhood(row, col, left, top, right, bottom);
 	int countAlive = 1; // We have at least one alive neighbor
-	for (int64_t r = top; r <= bottom; ++r)
+	// Step by offset so a neighbourhood clamped at MAX does not overflow the loop variable
+	for (uint64_t dr = 0; dr <= (uint64_t)(bottom - top); ++dr)
 	{
-		for (int64_t c = left; c <= right; ++c)
+		int64_t r = top + (int64_t)dr;
+		for (uint64_t dc = 0; dc <= (uint64_t)(right - left); ++dc)
 		{
+			int64_t c = left + (int64_t)dc;
 			if (r == row && c == col)
 				continue;
 			if (r == alive_neighbour_row && c == alive_neighbour_col)
@@ -71,10 +74,12 @@ void BoardUpdater::UpdateAliveCellStatus(Board& board, int64_t row, int64_t col)
 	int64_t left, top, right, bottom;
 	GetNeighbourhood(row, col, left, top, right, bottom);
 	int countAlive = 0;
-	for (int64_t r = top; r <= bottom; ++r)
+	for (uint64_t dr = 0; dr <= (uint64_t)(bottom - top); ++dr)
 	{
-		for (int64_t c = left; c <= right; ++c)
+		int64_t r = top + (int64_t)dr;
+		for (uint64_t dc = 0; dc <= (uint64_t)(right - left); ++dc)
 		{
+			int64_t c = left + (int64_t)dc;
 			if (r == row && c == col)
 				continue;
 			if (IsAlive(board, r, c))
@@ -160,3 +165,20 @@ void BoardUpdater::OnEnded(Board& board)
 	board.ApplyToggles();
 	m_cellCache.Clear();
 }
+
+/// <summary>
+/// Add the cell cache to a memory report
+/// </summary>
+/// <param name="report"></param>
+void BoardUpdater::ReportMemory(MemoryReport& report) const
+{
+	report.Add("cell cache", m_cellCache.GetMemoryUsage());
+}
+
+/// <summary>
+/// The cell cache only lives for one update
+/// </summary>
+void BoardUpdater::ReleaseMemory()
+{
+	m_cellCache.Clear();
+}
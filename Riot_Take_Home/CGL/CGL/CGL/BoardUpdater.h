@@ -1,12 +1,14 @@
 #pragma once
 
+#include <limits>
+
 #include "Board.h"
 #include "CellCache.h"
 
 /// <summary>
 /// BoardUpdater - visitor used to update the game pf life
 /// </summary>
-class BoardUpdater : public Board::Visitor
+class BoardUpdater final : public Board::StaticVisitor<BoardUpdater>
 {
 	const static int64_t MAX = std::numeric_limits<int64_t>::max();
 	const static int64_t MIN = std::numeric_limits<int64_t>::min();
@@ -43,5 +45,7 @@ public:
 	void OnStarted(Board& board) override;
 	bool Visit(Board& board, int64_t row, int64_t col) override;
 	void OnEnded(Board& board) override;
+	void ReportMemory(MemoryReport& report) const override;
+	void ReleaseMemory() override;
 };
 
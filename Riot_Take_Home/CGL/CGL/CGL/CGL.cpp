@@ -1,98 +1,566 @@
 
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <cstdint>
+#include <cstring>
 #include <exception>
+#include <fstream>
 #include <iostream>
-#include <string> 
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "BatchSimulator.h"
+#include "BatchedUpdater.h"
 #include "BoardUpdater.h"
 #include "CellCache.h"
+#include "Census.h"
+#include "DenseBoard.h"
+#include "DiffStream.h"
+#include "HistoryRecorder.h"
+#include "IslandSimulator.h"
+#include "LifeIO.h"
+#include "LutUpdater.h"
+#include "MemoryBudget.h"
+#include "NumaUpdater.h"
+#include "PerfCounters.h"
+#include "ResultCache.h"
+#include "ShardedSimulator.h"
+#include "SimulationServer.h"
+#include "SpaceshipTracker.h"
+#include "VerificationHarness.h"
 
 const size_t  NUM_ITERATIONS = 10;
 
-inline bool IsEmtptyOrWhiteSpace(const std::string& str)
+/// <summary>
+/// Command line options
+/// </summary>
+struct Options
 {
-	if (str.empty() || std::all_of(str.begin(), str.end(), [](char c) { return std::isspace(c); })) 
-		return true;
-    else
-		return false;
+    size_t m_generations = NUM_ITERATIONS;
+    bool m_batch = false;
+    size_t m_threads = 0;
+    std::string m_engine = "reference";
+    size_t m_memoryLimit = 0;   // bytes, 0 for no limit
+    MemoryBudget::Policy m_memoryPolicy = MemoryBudget::Policy::Abort;
+    bool m_memoryReport = false;
+    std::string m_pagedPath;    // file backed board storage from the start
+    std::string m_spillPath;    // file for the spill memory policy
+    std::string m_diffPath;     // per generation births and deaths, "-" for stdout
+    DiffWriter::Format m_diffFormat = DiffWriter::Format::Text;
+    std::string m_socketPath;   // server mode
+    bool m_bounded = false;     // dense fixed size universe instead of the unbounded plane
+    DenseBoard::Topology m_topology = DenseBoard::Topology::Torus;
+    size_t m_width = 0;
+    size_t m_height = 0;
+    bool m_census = false;      // object census of the final board
+    size_t m_censusGap = 0;
+    std::string m_verifyEngine; // verification mode: candidate engine checked against the reference
+    size_t m_soups = 8;
+    uint64_t m_seed = 1;
+    bool m_profile = false;     // hardware counters per generation and phase
+    size_t m_islandEpoch = 0;   // generations per island split, 0 to step the board as a whole
+    size_t m_historyInterval = 0; // generations between history keyframes, 0 for no history
+    size_t m_historyLimit = 0;  // bytes, 0 for no limit
+    std::vector<size_t> m_show; // past generations to print from the history
+    std::string m_cachePath;    // directory of results kept across runs
+    size_t m_cacheLimit = 256 * 1024 * 1024; // bytes, 0 for no limit
+    size_t m_shards = 0;        // row stripes stepped by worker processes, 0 to step in this process
+    std::string m_shardAddress; // transport the workers connect to
+    size_t m_shardSpawn = (size_t)-1; // workers forked here, the rest join from other hosts
+    size_t m_rebalance = 64;    // generations between stripe rebalancing, 0 for fixed stripes
+    std::string m_shardWorker;  // worker mode: coordinator address
+    size_t m_trackShips = 0;    // generations between spaceship captures, 0 to step spaceships on the board
+};
+
+/// <summary>
+/// Visitor to display board state
+/// </summary>
+class BoardOutput final : public Board::StaticVisitor<BoardOutput>
+{
+public:
+    virtual void OnStarted(Board& board)
+    {
+        std::cout << "#Life 1.06\n";
+    }
+
+    virtual bool Visit(Board& board, int64_t row, int64_t col)
+    {
+        std::cout << row << ' ' << col << '\n';
+        return true;
+    }
+};
+
+/// <summary>
+/// Create the board update visitor selected by name
+/// </summary>
+/// <param name="name"></param>
+/// <returns>null if there is no such engine</returns>
+std::unique_ptr<Board::Visitor> CreateEngine(const std::string& name)
+{
+    if (name == "reference")
+        return std::unique_ptr<Board::Visitor>(new BoardUpdater());
+    if (name == "batched")
+        return std::unique_ptr<Board::Visitor>(new BatchedUpdater());
+    if (name == "lut")
+        return std::unique_ptr<Board::Visitor>(new LutUpdater());
+    if (name == "numa")
+        return std::unique_ptr<Board::Visitor>(new NumaUpdater());
+    return nullptr;
 }
 
 /// <summary>
-/// Read input (row, col) from stdin
+/// Print command line usage
 /// </summary>
-/// <param name="row"></param>
-/// <param name="col"></param>
-/// <returns>true if success and false of end of file</returns>
-bool GetInput(int64_t& row, int64_t& col)
+void PrintUsage()
 {
-    std::string line;
-    if (std::getline(std::cin, line))
+    std::cerr << "Usage: CGL [--generations N] [--engine NAME] [--batch [--threads N]]\n"
+        "  --generations N   generations to simulate (default " << NUM_ITERATIONS << ")\n"
+        "  --engine NAME     update engine: reference (default), batched, lut or numa\n"
+        "                    (multi threaded, pinned to CPUs across NUMA nodes)\n"
+        "  --batch           read many Life 1.06 patterns, each with its own header,\n"
+        "                    and report population, period and bounding box of each\n"
+        "  --threads N       worker threads for --batch (default all hardware threads)\n"
+        "  --memory-limit MB stop with a memory report once board and engine use more\n"
+        "  --memory-policy P abort (default), compact: compact structures near the limit\n"
+        "                    or spill: compact, then move the board to a paged file\n"
+        "  --spill-file F    scratch file for --memory-policy spill\n"
+        "  --memory-report   print estimated memory use per structure to stderr at the end\n"
+        "  --paged F         keep the board in memory mapped tiles backed by scratch file F\n"
+        "  --diff-out F      stream births and deaths of every generation to F (- for stdout\n"
+        "                    instead of the banner and final board)\n"
+        "  --diff-format X   text (default) or binary varint delta encoding\n"
+        "  --serve PATH      keep boards resident and serve commands on Unix socket PATH\n"
+        "  --topology T      bounded universe: torus, klein or plane (hard edges)\n"
+        "  --size WxH        columns and rows of the bounded universe (default 4096x4096)\n"
+        "  --census          append a census of the objects on the final board as #C lines\n"
+        "  --census-gap N    empty cells allowed between cells of one census object (default 0)\n"
+        "  --verify NAME     step random soups, known and INT64 edge patterns on engine NAME\n"
+        "                    and the reference in lockstep, report divergences and timings\n"
+        "  --soups N         random soups per placement for --verify (default 8)\n"
+        "  --seed N          random seed for --verify (default 1)\n"
+        "  --profile         print cycles, instructions, cache and branch misses of the\n"
+        "                    evaluation and toggle passes of every generation to stderr\n"
+        "                    (single threaded engines only)\n"
+        "  --islands N       step clusters that can not meet within N generations on their\n"
+        "                    own, in parallel, splitting the board again every N generations\n"
+        "  --history N       record the run with a keyframe every N generations\n"
+        "  --history-limit MB  drop the oldest recorded generations beyond this size\n"
+        "  --show K          after the final board print generation K from the history\n"
+        "  --cache DIR       reuse final boards of earlier runs of the same pattern, at any\n"
+        "                    position, and the same generations, stored in DIR\n"
+        "  --cache-limit MB  drop the least recently used results beyond this size (default 256)\n"
+        "  --shards N        split the board in to N row stripes stepped by worker processes\n"
+        "  --shard-address A unix:PATH (default, in the temp directory) or tcp:HOST:PORT\n"
+        "  --shard-spawn K   fork K of the workers here (default N), the others join with\n"
+        "                    --shard-worker A from other hosts\n"
+        "  --rebalance N     generations between moving rows to even out stripe populations\n"
+        "                    (default 64, 0 for fixed stripes)\n"
+        "  --shard-worker A  serve one sharded run of the coordinator at address A\n"
+        "  --track-ships N   every N generations take escaping gliders and *WSS off the board\n"
+        "                    and move them analytically until something comes near\n";
+}
+
+/// <summary>
+/// Parse command line options
+/// </summary>
+/// <param name="argc"></param>
+/// <param name="argv"></param>
+/// <param name="options"></param>
+/// <returns>false if the command line is invalid</returns>
+bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
     {
-        std::size_t index = -1;
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
         try
         {
-            row = std::stoull(line, &index);
+            if (std::strcmp(arg, "--generations") == 0 && hasValue)
+                options.m_generations = std::stoull(argv[++i]);
+            else if (std::strcmp(arg, "--engine") == 0 && hasValue)
+                options.m_engine = argv[++i];
+            else if (std::strcmp(arg, "--batch") == 0)
+                options.m_batch = true;
+            else if (std::strcmp(arg, "--threads") == 0 && hasValue)
+                options.m_threads = std::stoull(argv[++i]);
+            else if (std::strcmp(arg, "--memory-limit") == 0 && hasValue)
+                options.m_memoryLimit = std::stoull(argv[++i]) * 1024 * 1024;
+            else if (std::strcmp(arg, "--memory-policy") == 0 && hasValue)
+            {
+                std::string policy = argv[++i];
+                if (policy == "abort")
+                    options.m_memoryPolicy = MemoryBudget::Policy::Abort;
+                else if (policy == "compact")
+                    options.m_memoryPolicy = MemoryBudget::Policy::Compact;
+                else if (policy == "spill")
+                    options.m_memoryPolicy = MemoryBudget::Policy::Spill;
+                else
+                    throw std::invalid_argument("memory policy");
+            }
+            else if (std::strcmp(arg, "--memory-report") == 0)
+                options.m_memoryReport = true;
+            else if (std::strcmp(arg, "--spill-file") == 0 && hasValue)
+                options.m_spillPath = argv[++i];
+            else if (std::strcmp(arg, "--paged") == 0 && hasValue)
+                options.m_pagedPath = argv[++i];
+            else if (std::strcmp(arg, "--serve") == 0 && hasValue)
+                options.m_socketPath = argv[++i];
+            else if (std::strcmp(arg, "--topology") == 0 && hasValue)
+            {
+                std::string topology = argv[++i];
+                if (topology == "torus")
+                    options.m_topology = DenseBoard::Topology::Torus;
+                else if (topology == "klein")
+                    options.m_topology = DenseBoard::Topology::KleinBottle;
+                else if (topology == "plane")
+                    options.m_topology = DenseBoard::Topology::Plane;
+                else
+                    throw std::invalid_argument("topology");
+                options.m_bounded = true;
+            }
+            else if (std::strcmp(arg, "--size") == 0 && hasValue)
+            {
+                std::string size = argv[++i];
+                size_t index = 0;
+                options.m_width = std::stoull(size, &index);
+                if (index >= size.size() || (size[index] != 'x' && size[index] != 'X'))
+                    throw std::invalid_argument("size");
+                options.m_height = std::stoull(size.substr(index + 1));
+                options.m_bounded = true;
+            }
+            else if (std::strcmp(arg, "--census") == 0)
+                options.m_census = true;
+            else if (std::strcmp(arg, "--census-gap") == 0 && hasValue)
+            {
+                options.m_censusGap = std::stoull(argv[++i]);
+                options.m_census = true;
+            }
+            else if (std::strcmp(arg, "--verify") == 0 && hasValue)
+                options.m_verifyEngine = argv[++i];
+            else if (std::strcmp(arg, "--soups") == 0 && hasValue)
+                options.m_soups = std::stoull(argv[++i]);
+            else if (std::strcmp(arg, "--seed") == 0 && hasValue)
+                options.m_seed = std::stoull(argv[++i]);
+            else if (std::strcmp(arg, "--profile") == 0)
+                options.m_profile = true;
+            else if (std::strcmp(arg, "--islands") == 0 && hasValue)
+            {
+                options.m_islandEpoch = std::stoull(argv[++i]);
+                if (options.m_islandEpoch == 0)
+                    throw std::invalid_argument("islands");
+            }
+            else if (std::strcmp(arg, "--history") == 0 && hasValue)
+            {
+                options.m_historyInterval = std::stoull(argv[++i]);
+                if (options.m_historyInterval == 0)
+                    throw std::invalid_argument("history");
+            }
+            else if (std::strcmp(arg, "--history-limit") == 0 && hasValue)
+                options.m_historyLimit = std::stoull(argv[++i]) * 1024 * 1024;
+            else if (std::strcmp(arg, "--show") == 0 && hasValue)
+                options.m_show.push_back(std::stoull(argv[++i]));
+            else if (std::strcmp(arg, "--cache") == 0 && hasValue)
+                options.m_cachePath = argv[++i];
+            else if (std::strcmp(arg, "--cache-limit") == 0 && hasValue)
+                options.m_cacheLimit = std::stoull(argv[++i]) * 1024 * 1024;
+            else if (std::strcmp(arg, "--shards") == 0 && hasValue)
+            {
+                options.m_shards = std::stoull(argv[++i]);
+                if (options.m_shards == 0)
+                    throw std::invalid_argument("shards");
+            }
+            else if (std::strcmp(arg, "--shard-address") == 0 && hasValue)
+                options.m_shardAddress = argv[++i];
+            else if (std::strcmp(arg, "--shard-spawn") == 0 && hasValue)
+                options.m_shardSpawn = std::stoull(argv[++i]);
+            else if (std::strcmp(arg, "--rebalance") == 0 && hasValue)
+                options.m_rebalance = std::stoull(argv[++i]);
+            else if (std::strcmp(arg, "--shard-worker") == 0 && hasValue)
+                options.m_shardWorker = argv[++i];
+            else if (std::strcmp(arg, "--track-ships") == 0 && hasValue)
+            {
+                options.m_trackShips = std::stoull(argv[++i]);
+                if (options.m_trackShips == 0)
+                    throw std::invalid_argument("track ships");
+            }
+            else if (std::strcmp(arg, "--diff-out") == 0 && hasValue)
+                options.m_diffPath = argv[++i];
+            else if (std::strcmp(arg, "--diff-format") == 0 && hasValue)
+            {
+                std::string format = argv[++i];
+                if (format == "text")
+                    options.m_diffFormat = DiffWriter::Format::Text;
+                else if (format == "binary")
+                    options.m_diffFormat = DiffWriter::Format::Binary;
+                else
+                    throw std::invalid_argument("diff format");
+            }
+            else
+            {
+                std::cerr << "Error:Unknown or incomplete option \"" << arg << "\"\n";
+                return false;
+            }
         }
-        catch (const std::invalid_argument&)
+        catch (const std::exception&)
         {
-			if (!IsEmtptyOrWhiteSpace(line))
-			{
-                throw std::invalid_argument("invalid input for row");
-			}
-            return false; // treat blank line as end of data, for test convenience.
+            std::cerr << "Error:Invalid value for \"" << arg << "\"\n";
+            return false;
         }
-        try
-        {
-            col = std::stoull(line.substr(index), &index);
-        }
-        catch (const std::invalid_argument&)
-        {
-            throw std::invalid_argument("invalid input for column");
-        }
-		if (IsEmtptyOrWhiteSpace(line.substr(index)))
-		{
-			throw std::invalid_argument("invalid input after column");
-		}
-        return true;
     }
-    else
+    if (!CreateEngine(options.m_engine))
+    {
+        std::cerr << "Error:Unknown engine \"" << options.m_engine << "\"\n";
+        return false;
+    }
+    if (!options.m_show.empty() && options.m_historyInterval == 0)
+        options.m_historyInterval = 16;
+    bool sparseOnly = !options.m_diffPath.empty() || options.m_historyInterval != 0 || !options.m_cachePath.empty() || options.m_profile
+        || options.m_memoryLimit != 0 || options.m_memoryReport || !options.m_pagedPath.empty() || options.m_islandEpoch != 0
+        || options.m_shards != 0 || options.m_trackShips != 0;
+    if (options.m_bounded && sparseOnly)
+    {
+        std::cerr << "Error:--topology and --size step a dense board, they can not be used with --diff-out, --history, --show, --cache, --profile, --memory-limit, --memory-report, --paged, --islands, --shards or --track-ships\n";
+        return false;
+    }
+    if (options.m_batch && (sparseOnly || options.m_bounded || options.m_census))
+    {
+        std::cerr << "Error:--batch only reports a summary line per pattern, it can not be used with --topology, --size, --census, --diff-out, --history, --show, --cache, --profile, --memory-limit, --memory-report, --paged, --islands, --shards or --track-ships\n";
+        return false;
+    }
+    if (options.m_islandEpoch != 0 && (!options.m_diffPath.empty() || options.m_profile || options.m_memoryLimit != 0 || options.m_historyInterval != 0))
+    {
+        std::cerr << "Error:--islands does not step the whole board every generation, it can not be used with --diff-out, --profile, --memory-limit or --history\n";
+        return false;
+    }
+    if (options.m_shards != 0 && (options.m_islandEpoch != 0 || !options.m_diffPath.empty() || options.m_profile || options.m_memoryLimit != 0 || options.m_historyInterval != 0))
+    {
+        std::cerr << "Error:--shards steps the board in other processes, it can not be used with --islands, --diff-out, --profile, --memory-limit or --history\n";
+        return false;
+    }
+    if (options.m_trackShips != 0 && (options.m_islandEpoch != 0 || options.m_shards != 0 || !options.m_diffPath.empty() || options.m_profile || options.m_historyInterval != 0))
     {
+        std::cerr << "Error:--track-ships keeps spaceships off the board, it can not be used with --islands, --shards, --diff-out, --profile or --history\n";
         return false;
     }
+    if (options.m_diffPath == "-" && (options.m_census || !options.m_show.empty()))
+    {
+        std::cerr << "Error:--diff-out - writes only the diff stream to stdout, it can not be used with --census or --show\n";
+        return false;
+    }
+    if (options.m_profile && options.m_engine == "numa")
+    {
+        std::cerr << "Error:--profile counts this thread only, it can not be used with --engine numa, which evaluates on its own worker threads\n";
+        return false;
+    }
+    if (!options.m_cachePath.empty() && (!options.m_diffPath.empty() || options.m_profile || options.m_historyInterval != 0))
+    {
+        std::cerr << "Error:--cache skips the generations of a cached result, it can not be used with --diff-out, --profile or --history\n";
+        return false;
+    }
+    if (!options.m_verifyEngine.empty() && !CreateEngine(options.m_verifyEngine))
+    {
+        std::cerr << "Error:Unknown engine \"" << options.m_verifyEngine << "\"\n";
+        return false;
+    }
+    return true;
 }
 
 /// <summary>
-/// Visitor to display board state
+/// Batch mode: simulate every pattern on stdin and report one line per pattern
 /// </summary>
-class BoardOutput : public Board::Visitor
+/// <param name="options"></param>
+/// <returns></returns>
+int RunBatch(const Options& options)
 {
-    virtual void OnStarted(Board& board)
+    std::vector<Pattern> patterns;
+    ReadPatterns(std::cin, patterns);
+
+    BatchSimulator simulator(options.m_generations, options.m_threads);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BatchSimulator::Result> results = simulator.Run(patterns);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "#index population period top left bottom right\n";
+    for (size_t i = 0; i < results.size(); ++i)
     {
-        std::cout << "#Life 1.06\n";
+        const BatchSimulator::Result& r = results[i];
+        std::cout << i << ' ' << r.m_population << ' ' << r.m_period;
+        if (r.m_empty)
+            std::cout << " - - - -\n";
+        else
+            std::cout << ' ' << r.m_top << ' ' << r.m_left << ' ' << r.m_bottom << ' ' << r.m_right << '\n';
     }
 
-    virtual bool Visit(Board& board, int64_t row, int64_t col)
+    double seconds = elapsed.count();
+    std::cerr << patterns.size() << " patterns, " << options.m_generations << " generations, "
+        << simulator.NumThreads() << " threads: " << seconds << "s";
+    if (seconds > 0)
+        std::cerr << " (" << patterns.size() / seconds << " patterns/s)";
+    std::cerr << '\n';
+    return 0;
+}
+
+/// <summary>
+/// Server mode: serve commands on a Unix socket until shut down
+/// </summary>
+/// <param name="options"></param>
+/// <returns></returns>
+int RunServer(const Options& options)
+{
+    std::string engine = options.m_engine;
+    SimulationServer server(options.m_socketPath, [engine]() { return CreateEngine(engine); });
+    std::cerr << "Serving on " << options.m_socketPath << '\n';
+    server.Run();
+    return 0;
+}
+
+/// <summary>
+/// Shard worker mode: step stripes for a coordinator until it is done
+/// </summary>
+/// <param name="options"></param>
+/// <returns></returns>
+int RunShardWorker(const Options& options)
+{
+    ShardedSimulator::Work(options.m_shardWorker, CreateEngine);
+    return 0;
+}
+
+/// <summary>
+/// Verification mode: check an engine against the reference engine
+/// </summary>
+/// <param name="options"></param>
+/// <returns>0 if every case matched</returns>
+int RunVerify(const Options& options)
+{
+    std::string candidate = options.m_verifyEngine;
+    VerificationHarness harness([]() { return CreateEngine("reference"); },
+        [candidate]() { return CreateEngine(candidate); }, options.m_generations);
+    std::vector<VerificationHarness::Result> results = harness.Run(VerificationHarness::StandardCases(options.m_soups, options.m_seed));
+    results.push_back(VerificationHarness::VerifyCellSet(options.m_seed));
+    results.push_back(harness.VerifyDiffStream(DiffWriter::Format::Text, options.m_seed));
+    results.push_back(harness.VerifyDiffStream(DiffWriter::Format::Binary, options.m_seed));
+    return VerificationHarness::Print(std::cout, results) ? 0 : 1;
+}
+
+/// <summary>
+/// Print the census of a board as Life 1.06 comment lines: count, cells per object, canonical hash and name
+/// </summary>
+/// <param name="board"></param>
+/// <param name="options"></param>
+void PrintCensus(Board& board, const Options& options)
+{
+    Census census(options.m_censusGap, options.m_threads);
+    std::vector<Census::Tally> tallies = census.Run(board);
+    size_t objects = 0;
+    for (const auto& tally : tallies)
+        objects += tally.m_count;
+
+    std::cout << "#C objects " << objects << " distinct " << tallies.size() << '\n';
+    char hash[17];
+    for (const auto& tally : tallies)
     {
-        std::cout << row << ' ' << col << '\n';
-        return true;
+        std::snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)tally.m_hash);
+        std::cout << "#C " << tally.m_count << ' ' << tally.m_cells << ' ' << hash << ' '
+            << (tally.m_name.empty() ? "unknown" : tally.m_name) << '\n';
     }
-};
+}
 
 /// <summary>
-/// main
+/// Bounded mode: simulate the board on stdin in a dense fixed size universe
 /// </summary>
-/// <param name="argc"></param>
-/// <param name="argv"></param>
+/// <param name="options"></param>
 /// <returns></returns>
-int main(int argc, char* argv[])
+int RunBounded(const Options& options)
+{
+    std::string line;
+    std::getline(std::cin, line);
+    if (line != LIFE_106_HEADER)
+    {
+        std::cerr << "Error:Expecting input in Life 1.06 format, not \"" << line << "\"\n";
+        return 1;
+    }
+
+    size_t width = options.m_width != 0 ? options.m_width : 4096;
+    size_t height = options.m_height != 0 ? options.m_height : 4096;
+    DenseBoard dense(width, height, options.m_topology);
+    int64_t row = 0, col = 0;
+    while (GetInput(std::cin, row, col))
+    {
+        dense.Initialize(row, col);
+    }
+
+    for (size_t i = 0; i < options.m_generations; ++i)
+    {
+        dense.Step();
+    }
+
+    Board board;
+    dense.Export(board);
+    BoardOutput display;
+    board.Accept(&display);
+    if (options.m_census)
+        PrintCensus(board, options);
+    return 0;
+}
+
+/// <summary>
+/// Print a final board read from the result cache, in the order the board would visit it
+/// </summary>
+/// <param name="result"></param>
+/// <param name="options"></param>
+/// <returns></returns>
+int PrintCached(Pattern& result, const Options& options)
+{
+    std::sort(result.begin(), result.end(), [](const BoardState::Cell& a, const BoardState::Cell& b)
+    {
+        if (a.m_row != b.m_row)
+            return (uint64_t)a.m_row < (uint64_t)b.m_row;
+        return (uint64_t)a.m_col < (uint64_t)b.m_col;
+    });
+    std::string out = "#Life 1.06\n";
+    char line[48];
+    for (const auto& cell : result)
+    {
+        int length = std::snprintf(line, sizeof(line), "%lld %lld\n", (long long)cell.m_row, (long long)cell.m_col);
+        out.append(line, (size_t)length);
+    }
+    std::cout << out;
+
+    if (options.m_census || options.m_memoryReport)
+    {
+        Board board;
+        for (const auto& cell : result)
+            board.Initialize(cell.m_row, cell.m_col);
+        if (options.m_census)
+            PrintCensus(board, options);
+        if (options.m_memoryReport)
+        {
+            MemoryReport report;
+            board.ReportMemory(report);
+            report.Print(std::cerr);
+        }
+    }
+    return 0;
+}
+
+/// <summary>
+/// Single board mode: simulate the board on stdin and display the result
+/// </summary>
+/// <param name="options"></param>
+/// <returns></returns>
+int RunSingle(const Options& options)
 {
-    std::cout << "Conway's Game of life\nImplementation by Asim Naseer\nAwaiting input in Life 1.06 format (https://www.conwaylife.com/wiki/Life_1.06)\n...\n";
-    
+    // A diff stream on stdout must not be mixed with anything else
+    const bool diffToStdout = options.m_diffPath == "-";
+    if (!diffToStdout)
+        std::cout << "Conway's Game of life\nImplementation by Asim Naseer\nAwaiting input in Life 1.06 format (https://www.conwaylife.com/wiki/Life_1.06)\n...\n";
+
     {
         std::string line;
         std::getline(std::cin, line);
-        if (line != "#Life 1.06")
+        if (line != LIFE_106_HEADER)
         {
             std::cerr << "Error:Expecting input in Life 1.06 format, not \"" << line << "\"\n";
             return 1;
@@ -100,49 +568,199 @@ int main(int argc, char* argv[])
     }
 
     int64_t row = 0, col = 0;
-    try
+
+        // Initialize the board
+
+	Board board;
+    if (!options.m_pagedPath.empty())
+        board.UsePagedStorage(options.m_pagedPath);
+    while (GetInput(std::cin, row, col))
+    {
+        board.Initialize(row, col);
+    }
+
+	BoardOutput display;
+
+        // A cached result is printed straight from the entry
+
+    std::unique_ptr<ResultCache> cache;
+    Pattern initial;
+    if (!options.m_cachePath.empty())
+    {
+        cache.reset(new ResultCache(options.m_cachePath, options.m_cacheLimit));
+        board.ForEach([&initial](int64_t row, int64_t col) { initial.emplace_back(row, col); return true; });
+        Pattern result;
+        if (cache->Find(initial, options.m_generations, result))
+            return PrintCached(result, options);
+    }
+
+    std::unique_ptr<Board::Visitor> updater = CreateEngine(options.m_engine);
+    std::unique_ptr<SpaceshipTracker> tracker;
+    if (options.m_trackShips != 0)
+        tracker.reset(new SpaceshipTracker(options.m_trackShips, options.m_threads));
+    std::unique_ptr<MemoryBudget> budget;
+    if (options.m_memoryLimit != 0)
     {
-            // Initialize the board
+        budget.reset(new MemoryBudget(options.m_memoryLimit, options.m_memoryPolicy));
+        if (!options.m_spillPath.empty())
+            budget->SetSpillPath(options.m_spillPath);
+    }
 
-		Board board;
-        while (GetInput(row, col))
+    std::ofstream diffFile;
+    std::unique_ptr<DiffWriter> diff;
+    if (!options.m_diffPath.empty())
+    {
+        std::ostream* out = &std::cout;
+        if (options.m_diffPath != "-")
         {
-            board.Initialize(row, col);
+            diffFile.open(options.m_diffPath, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!diffFile)
+                throw std::runtime_error("cannot open \"" + options.m_diffPath + "\"");
+            out = &diffFile;
         }
+        diff.reset(new DiffWriter(*out, options.m_diffFormat));
+        diff->WriteInitial(board);
+        board.AddToggleObserver(diff.get());
+    }
+
+    std::unique_ptr<HistoryRecorder> history;
+    if (options.m_historyInterval != 0)
+    {
+        history.reset(new HistoryRecorder(options.m_historyInterval, options.m_historyLimit));
+        history->RecordInitial(board);
+        board.AddToggleObserver(history.get());
+    }
 
-		BoardOutput display;
-        BoardUpdater updater;
+    // Added last so the other observers count as evaluation, not toggle application
+    std::unique_ptr<PhaseProfiler> profiler;
+    if (options.m_profile)
+    {
+        profiler.reset(new PhaseProfiler(std::cerr));
+        board.AddToggleObserver(profiler.get());
+    }
 #ifdef _DEBUG
-		std::cout << "-Initial State ---------------------- " << '\n';
-		board.Accept(&display);
-		std::cout << "================================= " << '\n';
+	std::cout << "-Initial State ---------------------- " << '\n';
+	board.Accept(&display);
+	std::cout << "================================= " << '\n';
 #endif
 
-            // Update board a fixed number of times
+        // Update board a fixed number of times
 
-        for (size_t i = 0; i < NUM_ITERATIONS; ++i)
-        {
+    if (options.m_islandEpoch != 0)
+    {
+        std::string engine = options.m_engine;
+        IslandSimulator islands([engine]() { return CreateEngine(engine); }, options.m_islandEpoch, options.m_threads);
+        islands.Run(board, options.m_generations);
+        const IslandSimulator::Stats& stats = islands.GetStats();
+        std::cerr << "Islands: " << stats.m_epochs << " epochs, at most " << stats.m_maxIslands << " islands\n";
+    }
+    if (options.m_shards != 0)
+    {
+        ShardedSimulator shards(CreateEngine, options.m_engine, options.m_shards, options.m_shardAddress, options.m_shardSpawn, options.m_rebalance);
+        shards.Run(board, options.m_generations);
+        const ShardedSimulator::Stats& stats = shards.GetStats();
+        std::cerr << "Shards: " << stats.m_rebalances << " rebalances moved " << stats.m_cellsMoved << " cells, final populations";
+        for (uint64_t population : stats.m_populations)
+            std::cerr << ' ' << population;
+        std::cerr << '\n';
+    }
+    for (size_t i = 0; options.m_islandEpoch == 0 && options.m_shards == 0 && i < options.m_generations; ++i)
+    {
 #ifdef _DEBUG
-			std::cout << "================================= " << '\n';
-			std::cout << "Iteration: " << i << '\n';
+		std::cout << "================================= " << '\n';
+		std::cout << "Iteration: " << i << '\n';
 #endif
-            board.Accept(&updater);
+        if (profiler)
+            profiler->BeginGeneration();
+        board.Accept(updater.get());
+        if (tracker)
+            tracker->Advance(board);
+        if (profiler)
+            profiler->EndGeneration();
+        if (budget)
+            budget->Check(board, updater.get());
 #ifdef _DEBUG
-			std::cout << "-New State ---------------------- " << i << '\n';
-			board.Accept(&display);
-			std::cout << "================================= " << i << '\n';
+		std::cout << "-New State ---------------------- " << i << '\n';
+		board.Accept(&display);
+		std::cout << "================================= " << i << '\n';
 #endif
-        }
+    }
+
+    if (tracker)
+    {
+        const SpaceshipTracker::Stats& stats = tracker->GetStats();
+        std::cerr << "Spaceships: " << stats.m_captured << " captured, " << stats.m_released << " released early, "
+            << tracker->Tracked() << " tracked at the end, at most " << stats.m_maxTracked << '\n';
+        tracker->ReleaseAll(board);
+    }
 
-            // Display updated board
+        // Display updated board
 
+    if (!diffToStdout)
         board.Accept(&display);
+    if (cache)
+    {
+        Pattern result;
+        result.reserve(board.Size());
+        board.ForEach([&result](int64_t row, int64_t col) { result.emplace_back(row, col); return true; });
+        cache->Store(initial, options.m_generations, result);
     }
-    catch (std::exception e)
+    if (options.m_census)
+        PrintCensus(board, options);
+    if (profiler)
+        profiler->PrintTotals();
+    for (size_t generation : options.m_show)
     {
-        std::cerr << "Error:" << e.what() << "\nAborting...\n";
-        return 1;
+        Board past;
+        history->Materialize(generation, past);
+        std::cout << "#G " << generation << '\n';
+        past.Accept(&display);
+    }
+
+    if (options.m_memoryReport)
+    {
+        MemoryReport report;
+        board.ReportMemory(report);
+        updater->ReportMemory(report);
+        if (history)
+            history->ReportMemory(report);
+        report.Print(std::cerr);
     }
     return 0;
 }
 
+/// <summary>
+/// main
+/// </summary>
+/// <param name="argc"></param>
+/// <param name="argv"></param>
+/// <returns></returns>
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    try
+    {
+        if (!options.m_socketPath.empty())
+            return RunServer(options);
+        if (!options.m_shardWorker.empty())
+            return RunShardWorker(options);
+        if (!options.m_verifyEngine.empty())
+            return RunVerify(options);
+        if (options.m_batch)
+            return RunBatch(options);
+        if (options.m_bounded)
+            return RunBounded(options);
+        return RunSingle(options);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error:" << e.what() << "\nAborting...\n";
+        return 1;
+    }
+}
@@ -172,3 +172,17 @@ bool CellCache::IsProcessed(int64_t row, int64_t col)
 	return false;
 }
 
+
+/// <summary>
+/// Estimated memory of the row and column maps and the LRU list
+/// </summary>
+/// <returns></returns>
+MemoryUsage CellCache::GetMemoryUsage() const
+{
+	MemoryUsage usage;
+	usage.AddNodes(m_rows.size(), sizeof(RowToColumns::value_type), m_rows.size() * sizeof(int64_t));
+	for (const auto& row : m_rows)
+		usage.AddNodes(row.second.size(), sizeof(ColumnToCell::value_type), row.second.size() * (sizeof(int64_t) + 2 * sizeof(bool)));
+	usage.AddNodes(m_refernces.size(), sizeof(BoardState::Cell), m_refernces.size() * sizeof(BoardState::Cell));
+	return usage;
+}
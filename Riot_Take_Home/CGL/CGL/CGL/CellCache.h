@@ -51,6 +51,8 @@ class CellCache
 		bool IsCached(int64_t row, int64_t col);
 		bool IsProcessed(int64_t row, int64_t col);
 
+		MemoryUsage GetMemoryUsage() const;
+
 
 };
 
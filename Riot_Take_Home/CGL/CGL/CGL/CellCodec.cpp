@@ -0,0 +1,101 @@
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "CellCodec.h"
+
+/// <summary>
+/// Append an unsigned LEB128 varint
+/// </summary>
+/// <param name="out"></param>
+/// <param name="value"></param>
+void CellCodec::PutVarint(std::string& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<char>(value));
+}
+
+/// <summary>
+/// Read an unsigned LEB128 varint
+/// </summary>
+/// <param name="in">:advanced past the varint</param>
+/// <param name="end"></param>
+/// <param name="value"></param>
+/// <returns>false if the input is truncated or the varint is too long</returns>
+bool CellCodec::GetVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64 && in < end; shift += 7)
+	{
+		uint8_t byte = *in++;
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+/// <summary>
+/// Sort cells by row, then column
+/// </summary>
+/// <param name="cells"></param>
+void CellCodec::Sort(std::vector<BoardState::Cell>& cells)
+{
+	std::sort(cells.begin(), cells.end(), [](const BoardState::Cell& a, const BoardState::Cell& b)
+	{
+		return a.m_row != b.m_row ? a.m_row < b.m_row : a.m_col < b.m_col;
+	});
+}
+
+/// <summary>
+/// Encode a cell list. Deltas use wrapping arithmetic so the full int64
+/// range round trips.
+/// </summary>
+/// <param name="cells"></param>
+/// <param name="out"></param>
+void CellCodec::Encode(const std::vector<BoardState::Cell>& cells, std::string& out)
+{
+	PutVarint(out, cells.size());
+	uint64_t prevRow = 0, prevCol = 0;
+	for (const auto& cell : cells)
+	{
+		uint64_t row = static_cast<uint64_t>(cell.m_row);
+		uint64_t col = static_cast<uint64_t>(cell.m_col);
+		if (row != prevRow)
+			prevCol = 0;
+		PutVarint(out, ZigZag(static_cast<int64_t>(row - prevRow)));
+		PutVarint(out, ZigZag(static_cast<int64_t>(col - prevCol)));
+		prevRow = row;
+		prevCol = col;
+	}
+}
+
+/// <summary>
+/// Decode a cell list written by Encode
+/// </summary>
+/// <param name="in">:advanced past the list</param>
+/// <param name="end"></param>
+/// <param name="cells"></param>
+void CellCodec::Decode(const uint8_t*& in, const uint8_t* end, std::vector<BoardState::Cell>& cells)
+{
+	uint64_t count = 0;
+	if (!GetVarint(in, end, count))
+		throw std::runtime_error("truncated cell list");
+	uint64_t row = 0, col = 0;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		uint64_t dRow = 0, dCol = 0;
+		if (!GetVarint(in, end, dRow) || !GetVarint(in, end, dCol))
+			throw std::runtime_error("truncated cell list");
+		uint64_t delta = static_cast<uint64_t>(UnZigZag(dRow));
+		if (delta != 0)
+			col = 0;
+		row += delta;
+		col += static_cast<uint64_t>(UnZigZag(dCol));
+		cells.push_back(BoardState::Cell(static_cast<int64_t>(row), static_cast<int64_t>(col)));
+	}
+}
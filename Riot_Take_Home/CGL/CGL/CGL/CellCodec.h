@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BoardState.h"
+
+/// <summary>
+/// Compact binary encoding of cell lists: a varint count followed by zig-zag
+/// varint deltas. The row delta is taken from the previous cell, the column
+/// delta from the previous cell of the same row (or 0 on a new row), so
+/// sorted clustered cells take 2-3 bytes each.
+/// </summary>
+class CellCodec
+{
+	public:
+
+		static void PutVarint(std::string& out, uint64_t value);
+		// Returns false if the input ends inside the varint
+		static bool GetVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value);
+
+		static inline uint64_t ZigZag(int64_t value)
+		{
+			return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+		}
+
+		static inline int64_t UnZigZag(uint64_t value)
+		{
+			return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+		}
+
+		// Sort cells by row, then column
+		static void Sort(std::vector<BoardState::Cell>& cells);
+
+		// Append cells to out. Any order works, sorted cells encode smallest
+		static void Encode(const std::vector<BoardState::Cell>& cells, std::string& out);
+		// Decode one cell list, appending to cells. Throws on truncated input
+		static void Decode(const uint8_t*& in, const uint8_t* end, std::vector<BoardState::Cell>& cells);
+};
@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "BoardUpdater.h"
+#include "Census.h"
+#include "Parallel.h"
+
+namespace
+{
+	/// <summary>
+	/// Collects the live cells of a board
+	/// </summary>
+	class CellCollector : public Board::Visitor
+	{
+		public:
+
+			Pattern& m_cells;
+
+			CellCollector(Pattern& cells) : m_cells(cells) {}
+
+			virtual bool Visit(Board& board, int64_t row, int64_t col)
+			{
+				m_cells.emplace_back(row, col);
+				return true;
+			}
+	};
+
+	bool Less(const BoardState::Cell& a, const BoardState::Cell& b)
+	{
+		return a.m_row < b.m_row || (a.m_row == b.m_row && a.m_col < b.m_col);
+	}
+
+	/// <summary>
+	/// A known object, drawn with '*' for live cells, and how many generations it takes to repeat
+	/// </summary>
+	struct KnownObject
+	{
+		const char* m_name;
+		size_t m_period;
+		std::vector<const char*> m_rows;
+	};
+
+	const std::vector<KnownObject>& KnownObjects()
+	{
+		static const std::vector<KnownObject> objects =
+		{
+			{ "block", 1, { "**", "**" } },
+			{ "beehive", 1, { ".**.", "*..*", ".**." } },
+			{ "loaf", 1, { ".**.", "*..*", ".*.*", "..*." } },
+			{ "boat", 1, { "**.", "*.*", ".*." } },
+			{ "ship", 1, { "**.", "*.*", ".**" } },
+			{ "tub", 1, { ".*.", "*.*", ".*." } },
+			{ "pond", 1, { ".**.", "*..*", "*..*", ".**." } },
+			{ "long boat", 1, { "**..", "*.*.", ".*.*", "..*." } },
+			{ "blinker", 2, { "***" } },
+			{ "toad", 2, { ".***", "***." } },
+			{ "beacon", 2, { "**..", "**..", "..**", "..**" } },
+			{ "pentadecathlon", 15, { "..*....*..", "**.****.**", "..*....*.." } },
+			{ "glider", 4, { ".*.", "..*", "***" } },
+			{ "LWSS", 4, { ".*..*", "*....", "*...*", "****." } },
+			{ "MWSS", 4, { "...*..", ".*...*", "*.....", "*....*", "*****." } },
+			{ "HWSS", 4, { "...**..", ".*....*", "*......", "*.....*", "******." } },
+		};
+		return objects;
+	}
+
+	/// <summary>
+	/// Canonical hash of every phase of every known object, mapped to its name
+	/// </summary>
+	std::unordered_map<uint64_t, std::string> BuildKnownNames()
+	{
+		std::unordered_map<uint64_t, std::string> names;
+		Board board;
+		BoardUpdater updater;
+		Pattern cells;
+		for (const auto& object : KnownObjects())
+		{
+			board.Clear();
+			for (size_t r = 0; r < object.m_rows.size(); ++r)
+				for (size_t c = 0; object.m_rows[r][c] != '\0'; ++c)
+					if (object.m_rows[r][c] == '*')
+						board.Initialize(r, c);
+
+			for (size_t phase = 0; phase < object.m_period; ++phase)
+			{
+				cells.clear();
+				CellCollector collector(cells);
+				board.Accept(&collector);
+				names.emplace(Census::CanonicalHash(cells), object.m_name);
+				board.Accept(&updater);
+			}
+		}
+		return names;
+	}
+}
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="gap">:empty cells allowed between two cells of one object</param>
+/// <param name="numThreads">:worker threads, 0 for hardware concurrency</param>
+Census::Census(size_t gap, size_t numThreads) : m_gap(gap), m_numThreads(numThreads)
+{
+	if (m_gap >= (size_t)std::numeric_limits<int64_t>::max())
+		throw std::invalid_argument("Census gap is too large");
+}
+
+/// <summary>
+/// Root of a cell's component, halving the path on the way
+/// </summary>
+/// <param name="cell"></param>
+/// <returns></returns>
+uint32_t Census::Find(uint32_t cell)
+{
+	for (;;)
+	{
+		uint32_t parent = m_parent[cell].load(std::memory_order_relaxed);
+		if (parent == cell)
+			return cell;
+		uint32_t grandParent = m_parent[parent].load(std::memory_order_relaxed);
+		if (parent != grandParent)
+			m_parent[cell].compare_exchange_weak(parent, grandParent, std::memory_order_relaxed);
+		cell = grandParent;
+	}
+}
+
+/// <summary>
+/// Join two components. Roots are only ever linked to a root with a smaller
+/// index, so concurrent unions can not form a cycle
+/// </summary>
+/// <param name="a"></param>
+/// <param name="b"></param>
+void Census::Union(uint32_t a, uint32_t b)
+{
+	for (;;)
+	{
+		a = Find(a);
+		b = Find(b);
+		if (a == b)
+			return;
+		if (a < b)
+			std::swap(a, b);
+		uint32_t expected = a;
+		if (m_parent[a].compare_exchange_weak(expected, b, std::memory_order_relaxed))
+			return;
+	}
+}
+
+/// <summary>
+/// Union every cell in [begin, end) with the cells after it in sort order that are in reach.
+/// Cells before it are in reach of the cell themselves, so every pair is seen once
+/// </summary>
+/// <param name="begin"></param>
+/// <param name="end"></param>
+void Census::LinkRange(size_t begin, size_t end)
+{
+	const int64_t reach = (int64_t)m_gap + 1;
+	const int64_t maxValue = std::numeric_limits<int64_t>::max();
+	const int64_t minValue = std::numeric_limits<int64_t>::min();
+
+	for (size_t i = begin; i < end; ++i)
+	{
+		const BoardState::Cell& cell = m_cells[i];
+		int64_t left = cell.m_col >= minValue + reach ? cell.m_col - reach : minValue;
+		int64_t right = cell.m_col <= maxValue - reach ? cell.m_col + reach : maxValue;
+
+		// Rest of the cell's own row
+		for (size_t j = i + 1; j < m_cells.size() && m_cells[j].m_row == cell.m_row && m_cells[j].m_col <= right; ++j)
+			Union((uint32_t)i, (uint32_t)j);
+
+		for (int64_t dr = 1; dr <= reach && cell.m_row <= maxValue - dr; ++dr)
+		{
+			BoardState::Cell from(cell.m_row + dr, left);
+			auto it = std::lower_bound(m_cells.begin() + i + 1, m_cells.end(), from, Less);
+			for (; it != m_cells.end() && it->m_row == from.m_row && it->m_col <= right; ++it)
+				Union((uint32_t)i, (uint32_t)(it - m_cells.begin()));
+		}
+	}
+}
+
+/// <summary>
+/// Split the board's live cells in to components
+/// </summary>
+/// <param name="board"></param>
+/// <returns>each component's cells, sorted by row then column</returns>
+std::vector<Pattern> Census::Components(Board& board)
+{
+	m_cells.clear();
+	m_cells.reserve(board.Size());
+	CellCollector collector(m_cells);
+	board.Accept(&collector);
+	std::sort(m_cells.begin(), m_cells.end(), Less);
+
+	if (m_cells.size() >= std::numeric_limits<uint32_t>::max())
+		throw std::runtime_error("Too many cells for a census");
+
+	if (m_parentSize < m_cells.size())
+	{
+		m_parent.reset(new std::atomic<uint32_t>[m_cells.size()]);
+		m_parentSize = m_cells.size();
+	}
+	for (size_t i = 0; i < m_cells.size(); ++i)
+		m_parent[i].store((uint32_t)i, std::memory_order_relaxed);
+
+	ParallelFor(m_cells.size(), m_numThreads, [this](size_t begin, size_t end, size_t)
+	{
+		LinkRange(begin, end);
+	});
+
+	// Roots have the smallest index of their component, so components come out in sort order of their first cell
+	std::vector<uint32_t> componentOf(m_cells.size());
+	std::vector<Pattern> components;
+	for (size_t i = 0; i < m_cells.size(); ++i)
+	{
+		uint32_t root = Find((uint32_t)i);
+		if (root == i)
+		{
+			componentOf[i] = (uint32_t)components.size();
+			components.emplace_back();
+		}
+		components[componentOf[root]].push_back(m_cells[i]);
+	}
+	return components;
+}
+
+/// <summary>
+/// Tally the board's components by canonical form
+/// </summary>
+/// <param name="board"></param>
+/// <returns>one entry per distinct object, most frequent first</returns>
+std::vector<Census::Tally> Census::Run(Board& board)
+{
+	std::vector<Pattern> components = Components(board);
+	std::vector<uint64_t> hashes(components.size());
+	ParallelFor(components.size(), m_numThreads, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i = begin; i < end; ++i)
+			hashes[i] = CanonicalHash(components[i]);
+	});
+
+	std::unordered_map<uint64_t, Tally> tallies;
+	for (size_t i = 0; i < components.size(); ++i)
+	{
+		Tally& tally = tallies[hashes[i]];
+		if (tally.m_count++ == 0)
+		{
+			tally.m_hash = hashes[i];
+			tally.m_cells = components[i].size();
+			tally.m_name = KnownName(hashes[i]);
+		}
+	}
+
+	std::vector<Tally> result;
+	result.reserve(tallies.size());
+	for (auto& tally : tallies)
+		result.push_back(std::move(tally.second));
+	std::sort(result.begin(), result.end(), [](const Tally& a, const Tally& b)
+	{
+		if (a.m_count != b.m_count)
+			return a.m_count > b.m_count;
+		if (a.m_cells != b.m_cells)
+			return a.m_cells < b.m_cells;
+		return a.m_hash < b.m_hash;
+	});
+	return result;
+}
+
+/// <summary>
+/// FNV-1a hash of the smallest of the pattern's 8 rotations and reflections,
+/// each moved so its bounding box starts at (0, 0) and sorted
+/// </summary>
+/// <param name="pattern"></param>
+/// <returns></returns>
+uint64_t Census::CanonicalHash(const Pattern& pattern)
+{
+	typedef std::pair<uint64_t, uint64_t> Offset;
+	std::vector<Offset> best;
+	std::vector<Offset> candidate(pattern.size());
+
+	for (int transform = 0; transform < 8; ++transform)
+	{
+		// Offsets are taken in wrapping arithmetic, so only the relative placement matters
+		for (size_t i = 0; i < pattern.size(); ++i)
+		{
+			uint64_t r = (uint64_t)pattern[i].m_row;
+			uint64_t c = (uint64_t)pattern[i].m_col;
+			if (transform & 1)
+				r = 0 - r;
+			if (transform & 2)
+				c = 0 - c;
+			if (transform & 4)
+				std::swap(r, c);
+			candidate[i] = Offset(r, c);
+		}
+
+		// Subtract the bounding box corner, measured relative to the first cell so no offset wraps
+		int64_t top = 0;
+		int64_t left = 0;
+		for (const auto& offset : candidate)
+		{
+			top = std::min(top, (int64_t)(offset.first - candidate[0].first));
+			left = std::min(left, (int64_t)(offset.second - candidate[0].second));
+		}
+		uint64_t originRow = candidate.empty() ? 0 : candidate[0].first + (uint64_t)top;
+		uint64_t originCol = candidate.empty() ? 0 : candidate[0].second + (uint64_t)left;
+		for (auto& offset : candidate)
+			offset = Offset(offset.first - originRow, offset.second - originCol);
+
+		std::sort(candidate.begin(), candidate.end());
+		if (transform == 0 || candidate < best)
+			best.swap(candidate);
+		candidate.resize(pattern.size());
+	}
+
+	uint64_t hash = 14695981039346656037ULL;
+	auto mix = [&hash](uint64_t value)
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			hash ^= (value >> (i * 8)) & 0xFF;
+			hash *= 1099511628211ULL;
+		}
+	};
+	mix(best.size());
+	for (const auto& offset : best)
+	{
+		mix(offset.first);
+		mix(offset.second);
+	}
+	return hash;
+}
+
+/// <summary>
+/// Name of a known object
+/// </summary>
+/// <param name="hash">:canonical hash of the object</param>
+/// <returns>its name, empty if unknown</returns>
+std::string Census::KnownName(uint64_t hash)
+{
+	static const std::unordered_map<uint64_t, std::string> names = BuildKnownNames();
+	auto it = names.find(hash);
+	return it == names.end() ? std::string() : it->second;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Board.h"
+#include "LifeIO.h"
+
+/// <summary>
+/// Object census of a board. Live cells are split in to connected components
+/// (cells within the Life neighbourhood, widened by a gap, belong together)
+/// with a parallel lock free union-find. Every component is brought to a
+/// canonical form under the 8 rotations and reflections and tallied by the
+/// hash of that form; known still lifes, oscillators and spaceships are named.
+/// </summary>
+class Census
+{
+	public:
+
+		/// <summary>
+		/// One kind of object and how often it was found
+		/// </summary>
+		struct Tally
+		{
+			uint64_t m_hash = 0;
+			std::string m_name;		// Empty if not a known object
+			size_t m_cells = 0;
+			size_t m_count = 0;
+		};
+
+	private:
+
+		size_t m_gap = 0;
+		size_t m_numThreads = 0;
+		std::vector<BoardState::Cell> m_cells;		// Sorted by row, then column
+		std::unique_ptr<std::atomic<uint32_t>[]> m_parent;
+		size_t m_parentSize = 0;
+
+		uint32_t Find(uint32_t cell);
+		void Union(uint32_t a, uint32_t b);
+		void LinkRange(size_t begin, size_t end);
+
+	public:
+
+		// gap: empty cells allowed between two cells of one object, 0 for plain Life neighbours
+		Census(size_t gap = 0, size_t numThreads = 0);
+
+		// Split the board's live cells in to components, each a list of its cells
+		std::vector<Pattern> Components(Board& board);
+
+		// Components, tallied by canonical form, most frequent first
+		std::vector<Tally> Run(Board& board);
+
+		// Hash of a pattern's canonical form, the same for all its rotations, reflections and translations
+		static uint64_t CanonicalHash(const Pattern& pattern);
+		// Name of a known object with this canonical hash, empty if unknown
+		static std::string KnownName(uint64_t hash);
+};
@@ -0,0 +1,223 @@
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "BitOps.h"
+#include "DenseBoard.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="width">:columns</param>
+/// <param name="height">:rows</param>
+/// <param name="topology"></param>
+DenseBoard::DenseBoard(size_t width, size_t height, Topology topology) : m_width(width), m_height(height), m_topology(topology)
+{
+	if (width == 0 || height == 0)
+		throw std::invalid_argument("dense board cannot be empty");
+
+	m_words = (width + 63) / 64;
+	size_t lastBits = width % 64;
+	m_lastMask = lastBits == 0 ? ~0ULL : (1ULL << lastBits) - 1;
+
+	m_cur.assign(m_words * m_height, 0);
+	m_next.assign(m_words * m_height, 0);
+	m_zero.assign(m_words, 0);
+	m_mirrorTop.assign(m_words, 0);
+	m_mirrorBottom.assign(m_words, 0);
+	for (size_t i = 0; i < 3; ++i)
+	{
+		m_west[i].assign(m_words, 0);
+		m_east[i].assign(m_words, 0);
+	}
+}
+
+/// <summary>
+/// Kill all cells
+/// </summary>
+void DenseBoard::Clear()
+{
+	std::fill(m_cur.begin(), m_cur.end(), 0);
+}
+
+/// <summary>
+/// Bring a cell to life
+/// </summary>
+/// <param name="row"></param>
+/// <param name="col"></param>
+void DenseBoard::Initialize(int64_t row, int64_t col)
+{
+	int64_t h = static_cast<int64_t>(m_height);
+	int64_t w = static_cast<int64_t>(m_width);
+	if (m_topology == Topology::Plane)
+	{
+		if (row < 0 || row >= h || col < 0 || col >= w)
+			throw std::out_of_range("cell outside the bounded plane");
+	}
+	else
+	{
+		// Floor division, so negative coordinates wrap the same way as positive ones
+		int64_t turns = row / h - (row % h < 0 ? 1 : 0);
+		row -= turns * h;
+		col = (col % w + w) % w;
+		if (m_topology == Topology::KleinBottle && (turns & 1))
+			col = w - 1 - col;
+	}
+	Row(m_cur, static_cast<size_t>(row))[col / 64] |= 1ULL << (col % 64);
+}
+
+/// <summary>
+/// Status of a cell inside the universe
+/// </summary>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns>false for cells outside</returns>
+bool DenseBoard::IsAlive(int64_t row, int64_t col) const
+{
+	if (row < 0 || col < 0 || row >= static_cast<int64_t>(m_height) || col >= static_cast<int64_t>(m_width))
+		return false;
+	return (m_cur[static_cast<size_t>(row) * m_words + static_cast<size_t>(col) / 64] >> (col % 64)) & 1;
+}
+
+/// <summary>
+/// Number of live cells
+/// </summary>
+/// <returns></returns>
+size_t DenseBoard::Size() const
+{
+	size_t count = 0;
+	for (uint64_t word : m_cur)
+		count += PopCount(word);
+	return count;
+}
+
+/// <summary>
+/// Reverse a row left to right, for the Klein bottle's mirrored edge
+/// </summary>
+/// <param name="in"></param>
+/// <param name="out"></param>
+void DenseBoard::Mirror(const uint64_t* in, uint64_t* out) const
+{
+	for (size_t i = 0; i < m_words; ++i)
+		out[i] = 0;
+	for (size_t i = 0; i < m_words; ++i)
+	{
+		for (uint64_t bits = in[i]; bits != 0; bits &= bits - 1)
+		{
+			size_t x = m_width - 1 - (i * 64 + LowestBit(bits));
+			out[x / 64] |= 1ULL << (x % 64);
+		}
+	}
+}
+
+/// <summary>
+/// Shift a row so bit x of west holds cell x - 1 and bit x of east holds
+/// cell x + 1. Off edge cells are dead on a plane and wrap otherwise.
+/// </summary>
+/// <param name="in"></param>
+/// <param name="west"></param>
+/// <param name="east"></param>
+void DenseBoard::Shift(const uint64_t* in, uint64_t* west, uint64_t* east) const
+{
+	bool wrap = m_topology != Topology::Plane;
+	size_t last = m_words - 1;
+
+	for (size_t i = 0; i < m_words; ++i)
+	{
+		west[i] = (in[i] << 1) | (i > 0 ? in[i - 1] >> 63 : 0);
+		east[i] = (in[i] >> 1) | (i < last ? in[i + 1] << 63 : 0);
+	}
+	if (wrap)
+	{
+		size_t lastBit = (m_width - 1) % 64;
+		west[0] |= (in[last] >> lastBit) & 1;
+		east[last] |= (in[0] & 1) << lastBit;
+	}
+	west[last] &= m_lastMask;
+}
+
+/// <summary>
+/// Compute the next state of one row. The 8 neighbour planes are summed with
+/// bit sliced counters: ones and twos hold the low bits of the count, fours
+/// records a count of 4 or more.
+/// </summary>
+/// <param name="above"></param>
+/// <param name="row"></param>
+/// <param name="below"></param>
+/// <param name="out"></param>
+void DenseBoard::StepRow(const uint64_t* above, const uint64_t* row, const uint64_t* below, uint64_t* out)
+{
+	const uint64_t* rows[3] = { above, row, below };
+	for (size_t i = 0; i < 3; ++i)
+		Shift(rows[i], m_west[i].data(), m_east[i].data());
+
+	for (size_t w = 0; w < m_words; ++w)
+	{
+		const uint64_t neighbours[8] =
+		{
+			m_west[0][w], above[w], m_east[0][w],
+			m_west[1][w], m_east[1][w],
+			m_west[2][w], below[w], m_east[2][w]
+		};
+
+		uint64_t ones = 0, twos = 0, fours = 0;
+		for (uint64_t n : neighbours)
+		{
+			uint64_t carry = ones & n;
+			ones ^= n;
+			fours |= twos & carry;
+			twos ^= carry;
+		}
+		// Alive next with exactly 3 neighbours, or 2 when alive now
+		out[w] = ~fours & twos & (ones | row[w]);
+	}
+	out[m_words - 1] &= m_lastMask;
+}
+
+/// <summary>
+/// Advance one generation
+/// </summary>
+void DenseBoard::Step()
+{
+	const uint64_t* haloTop = m_zero.data();
+	const uint64_t* haloBottom = m_zero.data();
+	if (m_topology == Topology::Torus)
+	{
+		haloTop = Row(m_cur, m_height - 1);
+		haloBottom = Row(m_cur, 0);
+	}
+	else if (m_topology == Topology::KleinBottle)
+	{
+		Mirror(Row(m_cur, m_height - 1), m_mirrorTop.data());
+		Mirror(Row(m_cur, 0), m_mirrorBottom.data());
+		haloTop = m_mirrorTop.data();
+		haloBottom = m_mirrorBottom.data();
+	}
+
+	for (size_t r = 0; r < m_height; ++r)
+	{
+		const uint64_t* above = r == 0 ? haloTop : Row(m_cur, r - 1);
+		const uint64_t* below = r == m_height - 1 ? haloBottom : Row(m_cur, r + 1);
+		StepRow(above, Row(m_cur, r), below, Row(m_next, r));
+	}
+	m_cur.swap(m_next);
+}
+
+/// <summary>
+/// Copy live cells to a board
+/// </summary>
+/// <param name="board"></param>
+void DenseBoard::Export(Board& board) const
+{
+	for (size_t r = 0; r < m_height; ++r)
+	{
+		const uint64_t* row = &m_cur[r * m_words];
+		for (size_t i = 0; i < m_words; ++i)
+		{
+			for (uint64_t bits = row[i]; bits != 0; bits &= bits - 1)
+			{
+				board.Initialize(static_cast<int64_t>(r), static_cast<int64_t>(i * 64 + LowestBit(bits)));
+			}
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Board.h"
+
+/// <summary>
+/// Fixed size universe stored as a flat bit array, one bit per cell, rows
+/// padded to whole 64 bit words. Two buffers are kept and swapped every
+/// generation; each step computes 64 cells at a time with bit sliced adders.
+/// The rows above the first and below the last row (the halo) and the columns
+/// beyond the edges come from the topology.
+/// </summary>
+class DenseBoard
+{
+	public:
+
+		enum class Topology
+		{
+			Plane,		// Hard edges, everything outside is dead
+			Torus,		// Both edge pairs wrap around
+			KleinBottle	// Left/right wrap, top/bottom wrap with the row mirrored
+		};
+
+	private:
+
+		size_t m_width = 0;
+		size_t m_height = 0;
+		size_t m_words = 0;			// Words per row
+		uint64_t m_lastMask = 0;	// Valid bits of the last word of a row
+		Topology m_topology = Topology::Plane;
+
+		std::vector<uint64_t> m_cur;
+		std::vector<uint64_t> m_next;
+		std::vector<uint64_t> m_zero;		// Halo row outside a hard edge
+		std::vector<uint64_t> m_mirrorTop;	// Klein bottle halo above row 0
+		std::vector<uint64_t> m_mirrorBottom;	// Klein bottle halo below the last row
+		std::vector<uint64_t> m_west[3];	// Scratch: rows shifted to line up west and east neighbours
+		std::vector<uint64_t> m_east[3];
+
+		inline uint64_t* Row(std::vector<uint64_t>& buffer, size_t row)
+		{
+			return &buffer[row * m_words];
+		}
+
+		void Mirror(const uint64_t* in, uint64_t* out) const;
+		void Shift(const uint64_t* in, uint64_t* west, uint64_t* east) const;
+		void StepRow(const uint64_t* above, const uint64_t* row, const uint64_t* below, uint64_t* out);
+
+	public:
+
+		DenseBoard(size_t width, size_t height, Topology topology);
+
+		inline size_t Width() const
+		{
+			return m_width;
+		}
+
+		inline size_t Height() const
+		{
+			return m_height;
+		}
+
+		inline Topology GetTopology() const
+		{
+			return m_topology;
+		}
+
+		void Clear();
+
+		// Bring a cell to life. Coordinates outside the universe are wrapped by
+		// the topology; on a plane they are out of range and throw.
+		void Initialize(int64_t row, int64_t col);
+		bool IsAlive(int64_t row, int64_t col) const;
+		size_t Size() const;
+
+		// Advance one generation
+		void Step();
+
+		// Copy all live cells in to a board, rows and columns start at 0
+		void Export(Board& board) const;
+};
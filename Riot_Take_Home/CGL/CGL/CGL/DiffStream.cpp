@@ -0,0 +1,231 @@
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "CellCodec.h"
+#include "DiffStream.h"
+
+const char DiffWriter::MAGIC[4] = { 'C', 'G', 'L', 'D' };
+
+/// <summary>
+/// ctor, writes the binary stream header
+/// </summary>
+/// <param name="out"></param>
+/// <param name="format"></param>
+DiffWriter::DiffWriter(std::ostream& out, Format format) : m_out(out), m_format(format)
+{
+	if (m_format == Format::Binary)
+	{
+		m_out.write(MAGIC, sizeof(MAGIC));
+		m_out.put(static_cast<char>(VERSION));
+	}
+}
+
+/// <summary>
+/// Write the collected births and deaths of m_generation
+/// </summary>
+void DiffWriter::WriteGeneration()
+{
+	CellCodec::Sort(m_births);
+	CellCodec::Sort(m_deaths);
+
+	if (m_format == Format::Text)
+	{
+		m_out << "#G " << m_generation << ' ' << m_births.size() << ' ' << m_deaths.size() << '\n';
+		for (const auto& c : m_births)
+			m_out << "+ " << c.m_row << ' ' << c.m_col << '\n';
+		for (const auto& c : m_deaths)
+			m_out << "- " << c.m_row << ' ' << c.m_col << '\n';
+	}
+	else
+	{
+		std::string record;
+		CellCodec::PutVarint(record, m_generation);
+		CellCodec::Encode(m_births, record);
+		CellCodec::Encode(m_deaths, record);
+		m_buffer.clear();
+		CellCodec::PutVarint(m_buffer, record.size());
+		m_out.write(m_buffer.data(), m_buffer.size());
+		m_out.write(record.data(), record.size());
+	}
+	m_out.flush();
+	if (!m_out)
+		throw std::runtime_error("cannot write diff stream");
+}
+
+/// <summary>
+/// Write all live cells as births of generation 0
+/// </summary>
+/// <param name="board"></param>
+void DiffWriter::WriteInitial(Board& board)
+{
+	class CollectVisitor : public Board::Visitor
+	{
+		public:
+			std::vector<BoardState::Cell>* m_cells = nullptr;
+
+			virtual bool Visit(Board& board, int64_t row, int64_t col)
+			{
+				m_cells->push_back(BoardState::Cell(row, col));
+				return true;
+			}
+	};
+
+	m_births.clear();
+	m_deaths.clear();
+	CollectVisitor cv;
+	cv.m_cells = &m_births;
+	board.Accept(&cv);
+	m_generation = 0;
+	WriteGeneration();
+}
+
+/// <summary>
+/// Split the pending toggles in to births and deaths and write them
+/// </summary>
+/// <param name="board"></param>
+/// <param name="toggled"></param>
+void DiffWriter::OnApplyStarted(Board& board, BoardState& toggled)
+{
+	class SplitVisitor : public BoardState::Visitor
+	{
+		public:
+			Board* m_board = nullptr;
+			DiffWriter* m_writer = nullptr;
+
+			virtual bool Visit(int64_t row, int64_t col)
+			{
+				if (m_board->IsAlive(row, col))
+					m_writer->m_deaths.push_back(BoardState::Cell(row, col));
+				else
+					m_writer->m_births.push_back(BoardState::Cell(row, col));
+				return true;
+			}
+	};
+
+	m_births.clear();
+	m_deaths.clear();
+	SplitVisitor sv;
+	sv.m_board = &board;
+	sv.m_writer = this;
+	toggled.Accept(&sv);
+	++m_generation;
+	WriteGeneration();
+}
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="in"></param>
+DiffReader::DiffReader(std::istream& in) : m_in(in), m_format(DiffWriter::Format::Binary)
+{
+	if (m_in.peek() == '#' || m_in.peek() == std::char_traits<char>::eof())
+	{
+		m_format = DiffWriter::Format::Text;
+		return;
+	}
+	char header[sizeof(DiffWriter::MAGIC) + 1];
+	if (!m_in.read(header, sizeof(header)) || std::string(header, sizeof(DiffWriter::MAGIC)) != std::string(DiffWriter::MAGIC, sizeof(DiffWriter::MAGIC)))
+		throw std::runtime_error("not a binary diff stream");
+	if (static_cast<uint8_t>(header[sizeof(DiffWriter::MAGIC)]) != DiffWriter::VERSION)
+		throw std::runtime_error("unsupported diff stream version");
+}
+
+/// <summary>
+/// Read one generation
+/// </summary>
+/// <param name="generation"></param>
+/// <param name="births">:replaced with the generation's births</param>
+/// <param name="deaths">:replaced with the generation's deaths</param>
+/// <returns>false at end of stream</returns>
+bool DiffReader::Read(uint64_t& generation, std::vector<BoardState::Cell>& births, std::vector<BoardState::Cell>& deaths)
+{
+	births.clear();
+	deaths.clear();
+	if (m_format == DiffWriter::Format::Text)
+		return ReadText(generation, births, deaths);
+	return ReadBinary(generation, births, deaths);
+}
+
+/// <summary>
+/// Read one "#G" record and its cell lines. Cells are collected as the lines
+/// arrive, the counts in the header only say how many lines follow
+/// </summary>
+/// <param name="generation"></param>
+/// <param name="births"></param>
+/// <param name="deaths"></param>
+/// <returns>false at end of stream</returns>
+bool DiffReader::ReadText(uint64_t& generation, std::vector<BoardState::Cell>& births, std::vector<BoardState::Cell>& deaths)
+{
+	std::string line;
+	if (!std::getline(m_in, line))
+		return false;
+	std::istringstream header(line);
+	std::string tag;
+	uint64_t numBirths = 0, numDeaths = 0;
+	if (!(header >> tag >> generation >> numBirths >> numDeaths) || tag != "#G")
+		throw std::runtime_error("corrupt diff stream");
+
+	for (uint64_t i = 0; i < numBirths + numDeaths; ++i)
+	{
+		if (!std::getline(m_in, line))
+			throw std::runtime_error("truncated diff stream");
+		std::istringstream cell(line);
+		char sign = 0;
+		int64_t row = 0, col = 0;
+		if (!(cell >> sign >> row >> col) || sign != (i < numBirths ? '+' : '-'))
+			throw std::runtime_error("corrupt diff stream");
+		(i < numBirths ? births : deaths).push_back(BoardState::Cell(row, col));
+	}
+	return true;
+}
+
+/// <summary>
+/// Read one length prefixed binary record
+/// </summary>
+/// <param name="generation"></param>
+/// <param name="births"></param>
+/// <param name="deaths"></param>
+/// <returns>false at end of stream</returns>
+bool DiffReader::ReadBinary(uint64_t& generation, std::vector<BoardState::Cell>& births, std::vector<BoardState::Cell>& deaths)
+{
+	uint64_t length = 0;
+	for (int shift = 0; ; shift += 7)
+	{
+		int byte = m_in.get();
+		if (byte == std::char_traits<char>::eof())
+		{
+			if (shift == 0)
+				return false;
+			throw std::runtime_error("truncated diff stream");
+		}
+		if (shift >= 64)
+			throw std::runtime_error("corrupt diff stream");
+		length |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			break;
+	}
+
+	if (length > MAX_RECORD_BYTES)
+		throw std::runtime_error("corrupt diff stream");
+
+	// Grow with the bytes that actually arrive rather than trusting the length up front
+	const size_t CHUNK = 1 << 20;
+	m_buffer.clear();
+	while (m_buffer.size() < length)
+	{
+		size_t received = m_buffer.size();
+		m_buffer.resize(received + std::min<size_t>(CHUNK, static_cast<size_t>(length) - received));
+		if (!m_in.read(&m_buffer[received], static_cast<std::streamsize>(m_buffer.size() - received)))
+			throw std::runtime_error("truncated diff stream");
+	}
+
+	const uint8_t* in = reinterpret_cast<const uint8_t*>(m_buffer.data());
+	const uint8_t* end = in + m_buffer.size();
+	if (!CellCodec::GetVarint(in, end, generation))
+		throw std::runtime_error("truncated diff stream");
+	CellCodec::Decode(in, end, births);
+	CellCodec::Decode(in, end, deaths);
+	return true;
+}
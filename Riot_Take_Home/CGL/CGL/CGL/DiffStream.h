@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Board.h"
+
+/// <summary>
+/// Writes the births and deaths of every generation as they are applied, so a
+/// consumer can replay a run from its initial state without full dumps.
+///
+/// Text format, one record per generation:
+///   #G generation births deaths
+///   + row col     (one line per birth)
+///   - row col     (one line per death)
+///
+/// Binary format: "CGLD" and a version byte, then per generation the varint
+/// byte length of a record holding the varint generation number followed by
+/// births and deaths as CellCodec lists.
+/// The initial board is written as generation 0 with every cell a birth.
+/// </summary>
+class DiffWriter : public Board::ToggleObserver
+{
+	public:
+
+		enum class Format
+		{
+			Text,
+			Binary
+		};
+
+		static const char MAGIC[4];
+		static const uint8_t VERSION = 1;
+
+	private:
+
+		std::ostream& m_out;
+		Format m_format;
+		uint64_t m_generation = 0;
+		std::vector<BoardState::Cell> m_births;
+		std::vector<BoardState::Cell> m_deaths;
+		std::string m_buffer;
+
+		void WriteGeneration();
+
+	public:
+
+		DiffWriter(std::ostream& out, Format format);
+
+		// Write the current board as generation 0, call before the first update
+		void WriteInitial(Board& board);
+
+		void OnApplyStarted(Board& board, BoardState& toggled) override;
+};
+
+/// <summary>
+/// Reads a diff stream written by DiffWriter, in either format
+/// </summary>
+class DiffReader
+{
+	public:
+
+		// Longer binary records are refused as corrupt rather than allocated
+		static const uint64_t MAX_RECORD_BYTES = 1ull << 30;
+
+	private:
+
+		std::istream& m_in;
+		DiffWriter::Format m_format;
+		std::string m_buffer;
+
+		bool ReadText(uint64_t& generation, std::vector<BoardState::Cell>& births, std::vector<BoardState::Cell>& deaths);
+		bool ReadBinary(uint64_t& generation, std::vector<BoardState::Cell>& births, std::vector<BoardState::Cell>& deaths);
+
+	public:
+
+		// Detects the format, reads and checks the binary stream header
+		DiffReader(std::istream& in);
+
+		inline DiffWriter::Format GetFormat() const
+		{
+			return m_format;
+		}
+
+		// Read the next generation, false at end of stream
+		bool Read(uint64_t& generation, std::vector<BoardState::Cell>& births, std::vector<BoardState::Cell>& deaths);
+};
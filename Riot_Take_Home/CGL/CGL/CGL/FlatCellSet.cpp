@@ -0,0 +1,189 @@
+
+#include <stdexcept>
+
+#include "FlatCellSet.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CGL_HASH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CGL_HASH_SSE2
+#endif
+
+// Multipliers for the folded row and column words
+static const uint32_t HASH_ROW_MUL = 0x9E3779B1u;
+static const uint32_t HASH_COL_MUL = 0x85EBCA77u;
+// Multiplier of the high word before it is folded in to the low word
+static const uint32_t HASH_HIGH_MUL = 0xC2B2AE3Du;
+
+/// <summary>
+/// Hash of a cell address. Each coordinate is folded to 32 bits and multiplied
+/// to 64 bits, which maps directly on to the SSE2/AVX2 32x32->64 multiply.
+/// The high word is multiplied before the fold, a plain xor would map the sign
+/// extension of -1 and 0 to the same value.
+/// </summary>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns></returns>
+uint64_t FlatCellSet::Hash(int64_t row, int64_t col)
+{
+	uint64_t ur = static_cast<uint64_t>(row);
+	uint64_t uc = static_cast<uint64_t>(col);
+	uint64_t fr = static_cast<uint32_t>(ur ^ (ur >> 32) * HASH_HIGH_MUL);
+	uint64_t fc = static_cast<uint32_t>(uc ^ (uc >> 32) * HASH_HIGH_MUL);
+	uint64_t h = fr * HASH_ROW_MUL + fc * HASH_COL_MUL;
+	return h ^ (h >> 29);
+}
+
+/// <summary>
+/// Hash a block of cells
+/// </summary>
+/// <param name="rows"></param>
+/// <param name="cols"></param>
+/// <param name="hashes">:output, count entries</param>
+/// <param name="count"></param>
+void FlatCellSet::HashBatch(const int64_t* rows, const int64_t* cols, uint64_t* hashes, size_t count)
+{
+	size_t i = 0;
+#if defined(CGL_HASH_AVX2)
+	const __m256i rowMul = _mm256_set1_epi64x(HASH_ROW_MUL);
+	const __m256i colMul = _mm256_set1_epi64x(HASH_COL_MUL);
+	const __m256i highMul = _mm256_set1_epi64x(HASH_HIGH_MUL);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + i));
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cols + i));
+		// Only the low 32 bits of each lane take part in the multiply
+		r = _mm256_xor_si256(r, _mm256_mul_epu32(_mm256_srli_epi64(r, 32), highMul));
+		c = _mm256_xor_si256(c, _mm256_mul_epu32(_mm256_srli_epi64(c, 32), highMul));
+		__m256i h = _mm256_add_epi64(_mm256_mul_epu32(r, rowMul), _mm256_mul_epu32(c, colMul));
+		h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 29));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(hashes + i), h);
+	}
+#elif defined(CGL_HASH_SSE2)
+	const __m128i rowMul = _mm_set_epi32(0, HASH_ROW_MUL, 0, HASH_ROW_MUL);
+	const __m128i colMul = _mm_set_epi32(0, HASH_COL_MUL, 0, HASH_COL_MUL);
+	const __m128i highMul = _mm_set_epi32(0, HASH_HIGH_MUL, 0, HASH_HIGH_MUL);
+	for (; i + 2 <= count; i += 2)
+	{
+		__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + i));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cols + i));
+		r = _mm_xor_si128(r, _mm_mul_epu32(_mm_srli_epi64(r, 32), highMul));
+		c = _mm_xor_si128(c, _mm_mul_epu32(_mm_srli_epi64(c, 32), highMul));
+		__m128i h = _mm_add_epi64(_mm_mul_epu32(r, rowMul), _mm_mul_epu32(c, colMul));
+		h = _mm_xor_si128(h, _mm_srli_epi64(h, 29));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(hashes + i), h);
+	}
+#endif
+	for (; i < count; ++i)
+		hashes[i] = Hash(rows[i], cols[i]);
+}
+
+/// <summary>
+/// Empty the set, sized so expected cells fit at half load
+/// </summary>
+/// <param name="expected"></param>
+void FlatCellSet::Clear(size_t expected)
+{
+	size_t capacity = MIN_CAPACITY;
+	while (capacity < expected * 2)
+		capacity <<= 1;
+	m_slots.assign(capacity, Slot());
+	m_mask = capacity - 1;
+	m_size = 0;
+}
+
+/// <summary>
+/// Empty the set and free the slot array
+/// </summary>
+void FlatCellSet::Release()
+{
+	std::vector<Slot>().swap(m_slots);
+	Clear(0);
+}
+
+/// <summary>
+/// Memory of the slot array, one allocation
+/// </summary>
+/// <returns></returns>
+MemoryUsage FlatCellSet::GetMemoryUsage() const
+{
+	MemoryUsage usage;
+	usage.AddBlocks(1, m_slots.capacity() * sizeof(Slot), m_size * 2 * sizeof(int64_t));
+	return usage;
+}
+
+/// <summary>
+/// Grow the slot array and re insert all cells
+/// </summary>
+/// <param name="capacity"></param>
+void FlatCellSet::Rehash(size_t capacity)
+{
+	std::vector<Slot> old;
+	old.swap(m_slots);
+	m_slots.assign(capacity, Slot());
+	m_mask = capacity - 1;
+	for (const Slot& slot : old)
+	{
+		if (slot.m_tag == 0)
+			continue;
+		size_t index = Home(slot.m_tag);
+		while (m_slots[index].m_tag != 0)
+			index = (index + 1) & m_mask;
+		m_slots[index] = slot;
+	}
+}
+
+/// <summary>
+/// Insert a cell
+/// </summary>
+/// <param name="hash">:Hash(row, col)</param>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns>true if the cell was added, false if it was already present</returns>
+bool FlatCellSet::Insert(uint64_t hash, int64_t row, int64_t col)
+{
+	if ((m_size + 1) * 2 > m_slots.size())
+		Rehash(m_slots.size() * 2);
+
+	uint64_t tag = hash | 1;
+	size_t index = Home(hash);
+	while (true)
+	{
+		Slot& slot = m_slots[index];
+		if (slot.m_tag == 0)
+		{
+			slot.m_tag = tag;
+			slot.m_row = row;
+			slot.m_col = col;
+			++m_size;
+			return true;
+		}
+		if (slot.m_tag == tag && slot.m_row == row && slot.m_col == col)
+			return false;
+		index = (index + 1) & m_mask;
+	}
+}
+
+/// <summary>
+/// Look up a cell
+/// </summary>
+/// <param name="hash">:Hash(row, col)</param>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns></returns>
+bool FlatCellSet::Contains(uint64_t hash, int64_t row, int64_t col) const
+{
+	uint64_t tag = hash | 1;
+	size_t index = Home(hash);
+	while (true)
+	{
+		const Slot& slot = m_slots[index];
+		if (slot.m_tag == 0)
+			return false;
+		if (slot.m_tag == tag && slot.m_row == row && slot.m_col == col)
+			return true;
+		index = (index + 1) & m_mask;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MemoryUsage.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/// <summary>
+/// Open addressing hash set of cell addresses stored in one flat array.
+/// Hashes are computed separately from the probe so a caller can hash a whole
+/// block of cells at once (SIMD) and prefetch the slots before probing them.
+/// </summary>
+class FlatCellSet
+{
+	private:
+
+		struct Slot
+		{
+			uint64_t m_tag = 0;	// hash | 1, 0 marks an empty slot
+			int64_t m_row = 0;
+			int64_t m_col = 0;
+		};
+
+		static const size_t MIN_CAPACITY = 64;
+
+		std::vector<Slot> m_slots;
+		size_t m_mask = 0;
+		size_t m_size = 0;
+
+		void Rehash(size_t capacity);
+
+		// First slot to probe. Skips bit 0 so the hash and its tag (hash | 1) start at the same slot
+		inline size_t Home(uint64_t hash) const
+		{
+			return static_cast<size_t>(hash >> 1) & m_mask;
+		}
+
+	public:
+
+		FlatCellSet() { Clear(0); }
+
+		inline size_t Size() const
+		{
+			return m_size;
+		}
+
+		// Empty the set and size it for expected number of cells
+		void Clear(size_t expected);
+		// Drop all cells and return the slot array to minimal size
+		void Release();
+
+		MemoryUsage GetMemoryUsage() const;
+
+		// Returns true if the cell was not yet in the set
+		bool Insert(uint64_t hash, int64_t row, int64_t col);
+		bool Contains(uint64_t hash, int64_t row, int64_t col) const;
+
+		// Hint the slot for hash in to cache ahead of Contains/Insert
+		inline void Prefetch(uint64_t hash) const
+		{
+			const Slot* slot = &m_slots[Home(hash)];
+#if defined(_MSC_VER)
+			_mm_prefetch(reinterpret_cast<const char*>(slot), _MM_HINT_T0);
+#else
+			__builtin_prefetch(slot);
+#endif
+		}
+
+		static uint64_t Hash(int64_t row, int64_t col);
+		// Hash count cells. Same results as Hash, vectorized where supported
+		static void HashBatch(const int64_t* rows, const int64_t* cols, uint64_t* hashes, size_t count);
+};
@@ -0,0 +1,171 @@
+#include <iterator>
+#include <stdexcept>
+
+#include "CellCodec.h"
+#include "HistoryRecorder.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="interval">:generations between keyframes</param>
+/// <param name="maxBytes">:recording size limit in bytes, 0 for no limit</param>
+HistoryRecorder::HistoryRecorder(size_t interval, size_t maxBytes) : m_interval(interval), m_maxBytes(maxBytes)
+{
+	if (m_interval == 0)
+		throw std::invalid_argument("History keyframe interval must be at least 1");
+}
+
+/// <summary>
+/// Encode all live cells of a board
+/// </summary>
+/// <param name="board"></param>
+/// <param name="out"></param>
+void HistoryRecorder::Encode(Board& board, std::string& out)
+{
+	m_cells.clear();
+	board.ForEach([this](int64_t row, int64_t col)
+	{
+		m_cells.emplace_back(row, col);
+		return true;
+	});
+	CellCodec::Sort(m_cells);
+	out.clear();
+	CellCodec::Encode(m_cells, out);
+}
+
+/// <summary>
+/// Keyframe the initial board
+/// </summary>
+/// <param name="board"></param>
+void HistoryRecorder::RecordInitial(Board& board)
+{
+	m_keyframes.clear();
+	m_toggles.clear();
+	m_generation = 0;
+	m_firstToggle = 1;
+	Encode(board, m_keyframes[0]);
+	m_bytes = m_keyframes[0].size();
+	m_started = true;
+}
+
+/// <summary>
+/// Record the toggles leading to the next generation
+/// </summary>
+/// <param name="board"></param>
+/// <param name="toggled"></param>
+void HistoryRecorder::OnApplyStarted(Board& board, BoardState& toggled)
+{
+	if (!m_started)
+		RecordInitial(board);
+
+	m_cells.clear();
+	toggled.ForEach([this](int64_t row, int64_t col)
+	{
+		m_cells.emplace_back(row, col);
+		return true;
+	});
+	CellCodec::Sort(m_cells);
+	m_toggles.emplace_back();
+	CellCodec::Encode(m_cells, m_toggles.back());
+	m_toggles.back().shrink_to_fit();
+	m_bytes += m_toggles.back().size();
+	++m_generation;
+}
+
+/// <summary>
+/// Keyframe the board if the interval is reached, then keep the size limit.
+/// Over the limit with a single keyframe nothing could be dropped, so the
+/// current generation is keyframed early and the older one goes
+/// </summary>
+/// <param name="board"></param>
+void HistoryRecorder::OnApplyEnded(Board& board)
+{
+	bool overLimit = m_maxBytes != 0 && m_bytes > m_maxBytes && m_keyframes.size() == 1;
+	if (m_generation % m_interval == 0 || (overLimit && m_keyframes.begin()->first != m_generation))
+	{
+		std::string& keyframe = m_keyframes[m_generation];
+		Encode(board, keyframe);
+		keyframe.shrink_to_fit();
+		m_bytes += keyframe.size();
+	}
+	Evict();
+}
+
+/// <summary>
+/// Drop the oldest keyframe and the toggles replayed from it while over the
+/// limit. The newest keyframe and the toggles after it are always kept.
+/// </summary>
+void HistoryRecorder::Evict()
+{
+	while (m_maxBytes != 0 && m_bytes > m_maxBytes && m_keyframes.size() > 1)
+	{
+		auto oldest = m_keyframes.begin();
+		uint64_t next = std::next(oldest)->first;
+		m_bytes -= oldest->second.size();
+		m_keyframes.erase(oldest);
+		for (; m_firstToggle <= next; ++m_firstToggle)
+		{
+			m_bytes -= m_toggles.front().size();
+			m_toggles.pop_front();
+		}
+	}
+}
+
+/// <summary>
+/// Oldest generation that can be rebuilt
+/// </summary>
+/// <returns></returns>
+uint64_t HistoryRecorder::OldestGeneration() const
+{
+	return m_keyframes.empty() ? 0 : m_keyframes.begin()->first;
+}
+
+/// <summary>
+/// Rebuild a recorded generation
+/// </summary>
+/// <param name="generation"></param>
+/// <param name="board">:cleared and filled with the generation's cells</param>
+void HistoryRecorder::Materialize(uint64_t generation, Board& board) const
+{
+	if (m_keyframes.empty() || generation < OldestGeneration() || generation > m_generation)
+		throw std::out_of_range("generation " + std::to_string(generation) + " is not in the recorded history");
+
+	auto keyframe = std::prev(m_keyframes.upper_bound(generation));
+	std::vector<BoardState::Cell> cells;
+	const uint8_t* in = reinterpret_cast<const uint8_t*>(keyframe->second.data());
+	CellCodec::Decode(in, in + keyframe->second.size(), cells);
+
+	board.Clear();
+	for (const auto& cell : cells)
+		board.Initialize(cell.m_row, cell.m_col);
+
+	for (uint64_t gen = keyframe->first + 1; gen <= generation; ++gen)
+	{
+		const std::string& toggles = m_toggles[gen - m_firstToggle];
+		cells.clear();
+		in = reinterpret_cast<const uint8_t*>(toggles.data());
+		CellCodec::Decode(in, in + toggles.size(), cells);
+		for (const auto& cell : cells)
+			board.QueueToggle(cell.m_row, cell.m_col);
+		board.ApplyToggles();
+	}
+}
+
+/// <summary>
+/// Add keyframes and toggle lists to a memory report
+/// </summary>
+/// <param name="report"></param>
+void HistoryRecorder::ReportMemory(MemoryReport& report) const
+{
+	MemoryUsage keyframes;
+	keyframes.AddNodes(m_keyframes.size(), sizeof(std::map<uint64_t, std::string>::value_type), 0);
+	for (const auto& keyframe : m_keyframes)
+		keyframes.AddBlocks(1, keyframe.second.capacity(), keyframe.second.size());
+	report.Add("history keyframes", keyframes);
+
+	MemoryUsage toggles;
+	toggles.AddBlocks(1, m_toggles.size() * sizeof(std::string), 0);
+	for (const auto& generation : m_toggles)
+		toggles.AddBlocks(1, generation.capacity(), generation.size());
+	report.Add("history toggles", toggles);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Board.h"
+
+/// <summary>
+/// Records a run so any recorded generation can be rebuilt later. A full
+/// keyframe of the board is kept every interval generations and the toggles
+/// of every generation in between, both as CellCodec lists. Generation k is
+/// rebuilt from the nearest keyframe at or before k by replaying toggles.
+/// Once the recording grows past its byte limit the oldest keyframe and its
+/// toggles are dropped, so the history becomes a sliding window; with a
+/// single keyframe left the current generation is keyframed early first.
+/// </summary>
+class HistoryRecorder : public Board::ToggleObserver
+{
+	private:
+
+		size_t m_interval;
+		size_t m_maxBytes;
+		uint64_t m_generation = 0;				// Generation of the board as last seen
+		std::map<uint64_t, std::string> m_keyframes;
+		std::deque<std::string> m_toggles;		// m_toggles[i] leads to generation m_firstToggle + i
+		uint64_t m_firstToggle = 1;
+		size_t m_bytes = 0;
+		bool m_started = false;
+		std::vector<BoardState::Cell> m_cells;	// Scratch
+
+		void Encode(Board& board, std::string& out);
+		void Evict();
+
+	public:
+
+		// interval: generations between keyframes, maxBytes: recording size limit, 0 for none
+		HistoryRecorder(size_t interval, size_t maxBytes = 0);
+
+		// Record the current board as generation 0, call before the first update
+		void RecordInitial(Board& board);
+
+		void OnApplyStarted(Board& board, BoardState& toggled) override;
+		void OnApplyEnded(Board& board) override;
+
+		// Oldest and newest generation that can be rebuilt
+		uint64_t OldestGeneration() const;
+		inline uint64_t NewestGeneration() const
+		{
+			return m_generation;
+		}
+
+		// Replace the contents of board with generation k. Throws std::out_of_range if k is not recorded
+		void Materialize(uint64_t generation, Board& board) const;
+
+		void ReportMemory(MemoryReport& report) const;
+};
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "Census.h"
+#include "IslandSimulator.h"
+#include "Parallel.h"
+
+namespace
+{
+	const int64_t MAX = std::numeric_limits<int64_t>::max();
+	const int64_t MIN = std::numeric_limits<int64_t>::min();
+}
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="factory">:creates one update engine per worker</param>
+/// <param name="epoch">:generations between island splits</param>
+/// <param name="numThreads">:worker threads, 0 for hardware concurrency</param>
+IslandSimulator::IslandSimulator(EngineFactory factory, size_t epoch, size_t numThreads) : m_epoch(epoch), m_numThreads(numThreads)
+{
+	if (!factory)
+		throw std::invalid_argument("engine factory cannot be null");
+	if (m_epoch == 0 || m_epoch > (size_t)std::numeric_limits<int32_t>::max())
+		throw std::invalid_argument("Island epoch must be between 1 and 2^31 generations");
+
+	if (m_numThreads == 0)
+		m_numThreads = std::thread::hardware_concurrency();
+	if (m_numThreads == 0)
+		m_numThreads = 1;
+	for (size_t i = 0; i < m_numThreads; ++i)
+	{
+		m_workers.emplace_back(new Worker());
+		m_workers.back()->m_engine = factory();
+	}
+}
+
+/// <summary>
+/// Step one island. Islands that may reach the edges of the plane within the
+/// epoch keep their coordinates so the walls stay where they are, all others
+/// are moved so their top left cell is at 0, 0.
+/// </summary>
+/// <param name="worker"></param>
+/// <param name="island">:cells sorted by row, then column</param>
+/// <param name="generations"></param>
+/// <param name="result">:island cells after the generations</param>
+void IslandSimulator::Simulate(Worker& worker, const Pattern& island, size_t generations, Pattern& result)
+{
+	int64_t top = island.front().m_row;
+	int64_t bottom = island.back().m_row;
+	int64_t left = island.front().m_col;
+	int64_t right = left;
+	for (const auto& cell : island)
+	{
+		left = std::min(left, cell.m_col);
+		right = std::max(right, cell.m_col);
+	}
+
+	const uint64_t reach = (uint64_t)generations + 1;
+	bool nearEdge = (uint64_t)top - (uint64_t)MIN <= reach || (uint64_t)MAX - (uint64_t)bottom <= reach
+		|| (uint64_t)left - (uint64_t)MIN <= reach || (uint64_t)MAX - (uint64_t)right <= reach;
+	const uint64_t originRow = nearEdge ? 0 : (uint64_t)top;
+	const uint64_t originCol = nearEdge ? 0 : (uint64_t)left;
+
+	Board& board = worker.m_board;
+	board.Clear();
+	for (const auto& cell : island)
+		board.Initialize((int64_t)((uint64_t)cell.m_row - originRow), (int64_t)((uint64_t)cell.m_col - originCol));
+	for (size_t gen = 0; gen < generations; ++gen)
+		board.Accept(worker.m_engine.get());
+
+	result.clear();
+	result.reserve(board.Size());
+	board.ForEach([&](int64_t row, int64_t col)
+	{
+		result.emplace_back((int64_t)((uint64_t)row + originRow), (int64_t)((uint64_t)col + originCol));
+		return true;
+	});
+}
+
+/// <summary>
+/// Advance the board, one epoch at a time
+/// </summary>
+/// <param name="board"></param>
+/// <param name="generations"></param>
+void IslandSimulator::Run(Board& board, size_t generations)
+{
+	std::vector<Pattern> results;
+	while (generations > 0 && board.Size() > 0)
+	{
+		size_t epoch = std::min(m_epoch, generations);
+
+		// Cells of different components are at least gap + 2 = 2 * epoch + 2 apart
+		Census census(2 * epoch, m_numThreads);
+		std::vector<Pattern> islands = census.Components(board);
+
+		// Biggest islands first, so the long ones do not start last
+		std::vector<size_t> order(islands.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&islands](size_t a, size_t b) { return islands[a].size() > islands[b].size(); });
+
+		results.resize(islands.size());
+		ParallelForEach(islands.size(), m_numThreads, [&](size_t i, size_t worker)
+		{
+			Simulate(*m_workers[worker], islands[order[i]], epoch, results[order[i]]);
+		});
+
+		board.Clear();
+		for (const auto& result : results)
+			for (const auto& cell : result)
+				board.Initialize(cell.m_row, cell.m_col);
+
+		++m_stats.m_epochs;
+		m_stats.m_maxIslands = std::max(m_stats.m_maxIslands, islands.size());
+		m_stats.m_islandSteps += islands.size() * epoch;
+		generations -= epoch;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Board.h"
+#include "LifeIO.h"
+
+/// <summary>
+/// Simulates far apart clusters of a board independently.
+/// Generations are run in epochs. At the start of an epoch of E generations
+/// live cells are split in to islands: cells of different islands are more
+/// than 2E + 1 apart, so by the speed of light (one cell per generation) they
+/// can not interact before the epoch ends. Islands are stepped in parallel,
+/// each on its own board moved to local coordinates, then merged back and
+/// split again for the next epoch, which joins islands that grew close.
+/// </summary>
+class IslandSimulator
+{
+	public:
+
+		typedef std::function<std::unique_ptr<Board::Visitor>()> EngineFactory;
+
+		struct Stats
+		{
+			size_t m_epochs = 0;
+			size_t m_maxIslands = 0;		// Most islands in one epoch
+			size_t m_islandSteps = 0;		// Sum over epochs of islands times generations
+		};
+
+	private:
+
+		/// <summary>
+		/// Board and engine reused by one worker thread
+		/// </summary>
+		struct Worker
+		{
+			Board m_board;
+			std::unique_ptr<Board::Visitor> m_engine;
+		};
+
+		size_t m_epoch = 0;
+		size_t m_numThreads = 0;
+		std::vector<std::unique_ptr<Worker>> m_workers;
+		Stats m_stats;
+
+		void Simulate(Worker& worker, const Pattern& island, size_t generations, Pattern& result);
+
+	public:
+
+		// epoch: generations between island splits, numThreads: 0 for hardware concurrency
+		IslandSimulator(EngineFactory factory, size_t epoch, size_t numThreads = 0);
+
+		// Advance the board by a number of generations. Toggle observers of the board are not notified
+		void Run(Board& board, size_t generations);
+
+		inline const Stats& GetStats() const
+		{
+			return m_stats;
+		}
+};
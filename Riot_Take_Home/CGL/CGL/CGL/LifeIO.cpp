@@ -0,0 +1,116 @@
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#include "LifeIO.h"
+
+const char* const LIFE_106_HEADER = "#Life 1.06";
+
+/// <summary>
+/// True if the string is empty or only holds white space
+/// </summary>
+/// <param name="str"></param>
+/// <returns></returns>
+bool IsEmtptyOrWhiteSpace(const std::string& str)
+{
+	return str.empty() || std::all_of(str.begin(), str.end(), [](char c) { return std::isspace(static_cast<unsigned char>(c)); });
+}
+
+/// <summary>
+/// Parse a single "row col" line
+/// </summary>
+/// <param name="line"></param>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns>true if a cell was parsed and false for a blank line</returns>
+bool ParseCell(const std::string& line, int64_t& row, int64_t& col)
+{
+	std::size_t index = 0;
+	try
+	{
+		row = std::stoll(line, &index);
+	}
+	catch (const std::invalid_argument&)
+	{
+		if (!IsEmtptyOrWhiteSpace(line))
+		{
+			throw std::invalid_argument("invalid input for row");
+		}
+		return false; // treat blank line as end of data, for test convenience.
+	}
+	catch (const std::out_of_range&)
+	{
+		throw std::invalid_argument("row out of range");
+	}
+
+	std::string rest = line.substr(index);
+	try
+	{
+		col = std::stoll(rest, &index);
+	}
+	catch (const std::invalid_argument&)
+	{
+		throw std::invalid_argument("invalid input for column");
+	}
+	catch (const std::out_of_range&)
+	{
+		throw std::invalid_argument("column out of range");
+	}
+	if (!IsEmtptyOrWhiteSpace(rest.substr(index)))
+	{
+		throw std::invalid_argument("invalid input after column");
+	}
+	return true;
+}
+
+/// <summary>
+/// Read input (row, col) from a stream
+/// </summary>
+/// <param name="in"></param>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns>true if success and false of end of file</returns>
+bool GetInput(std::istream& in, int64_t& row, int64_t& col)
+{
+	std::string line;
+	if (std::getline(in, line))
+	{
+		return ParseCell(line, row, col);
+	}
+	return false;
+}
+
+/// <summary>
+/// Read a sequence of Life 1.06 patterns. Every pattern starts with the
+/// Life 1.06 header line, blank lines and other '#' lines are ignored.
+/// </summary>
+/// <param name="in"></param>
+/// <param name="patterns">:read patterns are appended</param>
+/// <returns>number of patterns read</returns>
+size_t ReadPatterns(std::istream& in, std::vector<Pattern>& patterns)
+{
+	size_t count = 0;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line == LIFE_106_HEADER)
+		{
+			patterns.emplace_back();
+			++count;
+			continue;
+		}
+		if (!line.empty() && line[0] == '#')
+			continue;
+
+		int64_t row = 0, col = 0;
+		if (!ParseCell(line, row, col))
+			continue;
+		if (count == 0)
+			throw std::invalid_argument("cell found before \"#Life 1.06\" header");
+		patterns.back().push_back(BoardState::Cell(row, col));
+	}
+	return count;
+}
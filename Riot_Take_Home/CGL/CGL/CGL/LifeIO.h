@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "BoardState.h"
+
+// Life 1.06 ( https://www.conwaylife.com/wiki/Life_1.06 ) reading helpers
+
+extern const char* const LIFE_106_HEADER;
+
+typedef std::vector<BoardState::Cell> Pattern;
+
+bool IsEmtptyOrWhiteSpace(const std::string& str);
+
+// Parse a "row col" line. Returns false for a blank line, throws on malformed input
+bool ParseCell(const std::string& line, int64_t& row, int64_t& col);
+
+// Read input (row, col) from a stream. Returns false at end of data
+bool GetInput(std::istream& in, int64_t& row, int64_t& col);
+
+// Read any number of Life 1.06 patterns, each starting with its own header line
+size_t ReadPatterns(std::istream& in, std::vector<Pattern>& patterns);
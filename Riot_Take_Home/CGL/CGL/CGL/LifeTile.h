@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+#include "BitOps.h"
+#include "BlockTable.h"
+#include "BoardState.h"
+
+// 8x8 cell tiles packed in a 64 bit word: row r of a tile is byte r, column c
+// of that row is bit c. Tile addresses are cell addresses shifted right by
+// TILE_SHIFT, so the tile grid is aligned with the INT64 edges of the plane.
+
+const int TILE_SHIFT = 3;
+const int64_t TILE_MASK = 7;
+const int64_t MIN_TILE = std::numeric_limits<int64_t>::min() >> TILE_SHIFT;
+const int64_t MAX_TILE = std::numeric_limits<int64_t>::max() >> TILE_SHIFT;
+
+/// <summary>
+/// Address of a tile
+/// </summary>
+struct TileKey
+{
+	int64_t m_row = 0;
+	int64_t m_col = 0;
+
+	TileKey(int64_t r, int64_t c) : m_row(r), m_col(c) {}
+	bool operator==(const TileKey& other) const { return m_row == other.m_row && m_col == other.m_col; }
+};
+
+struct TileKeyHash
+{
+	size_t operator()(const TileKey& key) const { return static_cast<size_t>(BoardState::HashCell(key.m_row, key.m_col)); }
+};
+
+/// <summary>
+/// True if the tile next to key in direction dr, dc is on the plane
+/// </summary>
+inline bool HasNeighbourTile(const TileKey& key, int dr, int dc)
+{
+	return !((dr < 0 && key.m_row == MIN_TILE) || (dr > 0 && key.m_row == MAX_TILE)
+		|| (dc < 0 && key.m_col == MIN_TILE) || (dc > 0 && key.m_col == MAX_TILE));
+}
+
+/// <summary>
+/// Next state of the centre of a 3x3 group of tiles, by 16 lookups of a 4x4 -> 2x2 block table
+/// </summary>
+/// <param name="around">:tiles [row + 1][col + 1] around the centre, 0 past the edges of the plane</param>
+/// <returns></returns>
+template <typename Table>
+inline uint64_t StepTile(const uint64_t (&around)[3][3])
+{
+	// Tile rows -1 to 8 with one column of halo each side: bit 0 is column -1, bit 9 column 8
+	uint32_t rows[10];
+	for (int r = 0; r < 10; ++r)
+	{
+		int tileRow = r == 0 ? 0 : (r == 9 ? 2 : 1);
+		int shift = 8 * (r == 0 ? 7 : (r == 9 ? 0 : r - 1));
+		uint32_t west = (uint32_t)(around[tileRow][0] >> (shift + 7)) & 1;
+		uint32_t centre = (uint32_t)(around[tileRow][1] >> shift) & 0xFF;
+		uint32_t east = (uint32_t)(around[tileRow][2] >> shift) & 1;
+		rows[r] = west | centre << 1 | east << 9;
+	}
+
+	uint64_t next = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			uint32_t block = 0;
+			for (int r = 0; r < 4; ++r)
+				block |= (rows[2 * i + r] >> (2 * j) & 0xF) << (4 * r);
+			uint64_t centre = Table::TABLE[block];
+			next |= (centre & 3) << (16 * i + 2 * j);
+			next |= (centre >> 2) << (16 * i + 8 + 2 * j);
+		}
+	}
+	return next;
+}
+
+/// <summary>
+/// Call f(row, col) for every cell set in bits of the tile at key
+/// </summary>
+template <typename F>
+inline void ForEachTileCell(const TileKey& key, uint64_t bits, F&& f)
+{
+	const uint64_t rowBase = (uint64_t)key.m_row << TILE_SHIFT;
+	const uint64_t colBase = (uint64_t)key.m_col << TILE_SHIFT;
+	while (bits != 0)
+	{
+		int bit = LowestBit(bits);
+		bits &= bits - 1;
+		f((int64_t)(rowBase + (bit >> 3)), (int64_t)(colBase + (bit & 7)));
+	}
+}
@@ -0,0 +1,117 @@
+#include "LutUpdater.h"
+
+/// <summary>
+/// Tile at a tile address, 0 if it has no live cells or is off the plane
+/// </summary>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns></returns>
+uint64_t LutUpdater::GetTile(int64_t row, int64_t col) const
+{
+	auto it = m_tiles.find(TileKey(row, col));
+	return it == m_tiles.end() ? 0 : it->second;
+}
+
+/// <summary>
+/// Next state of a tile
+/// </summary>
+/// <param name="key"></param>
+/// <returns></returns>
+uint64_t LutUpdater::StepTile(const TileKey& key) const
+{
+	// Neighbouring tiles, [row + 1][col + 1], left empty past the edges of the plane
+	uint64_t around[3][3] = {};
+	for (int dr = -1; dr <= 1; ++dr)
+		for (int dc = -1; dc <= 1; ++dc)
+			if (HasNeighbourTile(key, dr, dc))
+				around[dr + 1][dc + 1] = GetTile(key.m_row + dr, key.m_col + dc);
+	return ::StepTile<Table>(around);
+}
+
+/// <summary>
+/// Queue a toggle for every changed cell of a tile
+/// </summary>
+/// <param name="board"></param>
+/// <param name="key"></param>
+/// <param name="changed">:old tile xor new tile</param>
+void LutUpdater::QueueChanges(Board& board, const TileKey& key, uint64_t changed)
+{
+	ForEachTileCell(key, changed, [&board](int64_t row, int64_t col) { board.QueueToggle(row, col); });
+}
+
+/// <summary>
+/// Called on visit start
+/// </summary>
+/// <param name="board"></param>
+void LutUpdater::OnStarted(Board& board)
+{
+	m_tiles.clear();
+	m_tiles.reserve(board.Size() / 4 + 1);
+}
+
+/// <summary>
+/// Set the live cell's bit in its tile
+/// </summary>
+/// <param name="board"></param>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns></returns>
+bool LutUpdater::Visit(Board& board, int64_t row, int64_t col)
+{
+	m_tiles[TileKey(row >> TILE_SHIFT, col >> TILE_SHIFT)] |= 1ULL << ((row & TILE_MASK) * 8 + (col & TILE_MASK));
+	return true;
+}
+
+/// <summary>
+/// Step all live tiles and the empty tiles next to them, then apply the changes
+/// </summary>
+/// <param name="board"></param>
+void LutUpdater::OnEnded(Board& board)
+{
+	m_fringe.clear();
+	for (const auto& tile : m_tiles)
+	{
+		const TileKey& key = tile.first;
+		for (int dr = -1; dr <= 1; ++dr)
+		{
+			for (int dc = -1; dc <= 1; ++dc)
+			{
+				TileKey neighbour(key.m_row + dr, key.m_col + dc);
+				if (HasNeighbourTile(key, dr, dc) && m_tiles.find(neighbour) == m_tiles.end())
+					m_fringe.insert(neighbour);
+			}
+		}
+	}
+
+	for (const auto& tile : m_tiles)
+		QueueChanges(board, tile.first, tile.second ^ StepTile(tile.first));
+	for (const auto& key : m_fringe)
+		QueueChanges(board, key, StepTile(key));
+
+	board.ApplyToggles();
+	m_tiles.clear();
+	m_fringe.clear();
+}
+
+/// <summary>
+/// Add the tile maps to a memory report
+/// </summary>
+/// <param name="report"></param>
+void LutUpdater::ReportMemory(MemoryReport& report) const
+{
+	MemoryUsage tiles;
+	tiles.AddNodes(m_tiles.size(), sizeof(Tiles::value_type), m_tiles.size() * sizeof(Tiles::value_type));
+	tiles.AddBlocks(1, m_tiles.bucket_count() * sizeof(void*), 0);
+	tiles.AddNodes(m_fringe.size(), sizeof(TileKey), m_fringe.size() * sizeof(TileKey));
+	tiles.AddBlocks(1, m_fringe.bucket_count() * sizeof(void*), 0);
+	report.Add("lut tiles", tiles);
+}
+
+/// <summary>
+/// The tiles only live for one update
+/// </summary>
+void LutUpdater::ReleaseMemory()
+{
+	Tiles().swap(m_tiles);
+	std::unordered_set<TileKey, TileKeyHash>().swap(m_fringe);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "BlockTable.h"
+#include "Board.h"
+#include "LifeTile.h"
+
+/// <summary>
+/// LutUpdater - visitor used to update the game of life, alternative to
+/// BoardUpdater for medium density boards.
+/// Live cells are gathered in to 8x8 bit tiles. Every tile, and every empty
+/// tile next to one, is stepped with 16 lookups of a compile time table that
+/// maps a 4x4 block to its next centre 2x2, so no cell is evaluated on its own.
+/// The tile grid is aligned with the INT64 edges of the plane, which are walls.
+/// </summary>
+class LutUpdater final : public Board::StaticVisitor<LutUpdater>
+{
+	typedef BlockTable<CONWAY_BIRTH, CONWAY_SURVIVE> Table;
+
+	typedef std::unordered_map<TileKey, uint64_t, TileKeyHash> Tiles;
+
+	Tiles m_tiles;
+	std::unordered_set<TileKey, TileKeyHash> m_fringe;	// Empty tiles next to live ones
+
+	uint64_t GetTile(int64_t row, int64_t col) const;
+	uint64_t StepTile(const TileKey& key) const;
+	void QueueChanges(Board& board, const TileKey& key, uint64_t changed);
+
+public:
+
+	LutUpdater() {}
+	virtual ~LutUpdater() {}
+
+	void OnStarted(Board& board) override;
+	bool Visit(Board& board, int64_t row, int64_t col) override;
+	void OnEnded(Board& board) override;
+	void ReportMemory(MemoryReport& report) const override;
+	void ReleaseMemory() override;
+};
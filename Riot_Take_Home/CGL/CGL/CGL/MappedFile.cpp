@@ -0,0 +1,192 @@
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+/// <summary>
+/// View offset alignment
+/// </summary>
+/// <returns></returns>
+size_t MappedFile::Granularity()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+#else
+	return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+/// <summary>
+/// dtor
+/// </summary>
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/// <summary>
+/// Create or truncate a file for reading and writing
+/// </summary>
+/// <param name="path"></param>
+/// <param name="scratch">:delete the file when it is closed</param>
+void MappedFile::Create(const std::string& path, bool scratch)
+{
+	Close();
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL | (scratch ? FILE_FLAG_DELETE_ON_CLOSE : 0), nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("cannot create \"" + path + "\"");
+	m_file = file;
+#else
+	m_file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (m_file < 0)
+		throw std::runtime_error("cannot create \"" + path + "\"");
+	if (scratch)
+		unlink(path.c_str());	// Storage is released when the descriptor is closed
+#endif
+	m_path = path;
+	m_size = 0;
+}
+
+/// <summary>
+/// Open an existing file for reading
+/// </summary>
+/// <param name="path"></param>
+void MappedFile::OpenReadOnly(const std::string& path)
+{
+	Close();
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("cannot open \"" + path + "\"");
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	m_file = file;
+	m_size = static_cast<uint64_t>(size.QuadPart);
+#else
+	m_file = open(path.c_str(), O_RDONLY);
+	if (m_file < 0)
+		throw std::runtime_error("cannot open \"" + path + "\"");
+	struct stat st;
+	fstat(m_file, &st);
+	m_size = static_cast<uint64_t>(st.st_size);
+#endif
+	m_path = path;
+}
+
+/// <summary>
+/// Close the file, views that are still mapped stay valid
+/// </summary>
+void MappedFile::Close()
+{
+	if (!IsOpen())
+		return;
+#if defined(_WIN32)
+	CloseHandle(m_file);
+	m_file = nullptr;
+#else
+	close(m_file);
+	m_file = -1;
+#endif
+	m_size = 0;
+}
+
+/// <summary>
+/// Grow or shrink the file
+/// </summary>
+/// <param name="size"></param>
+void MappedFile::Resize(uint64_t size)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER pos;
+	pos.QuadPart = static_cast<LONGLONG>(size);
+	if (!SetFilePointerEx(m_file, pos, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file))
+		throw std::runtime_error("cannot resize \"" + m_path + "\"");
+#else
+	if (ftruncate(m_file, static_cast<off_t>(size)) != 0)
+		throw std::runtime_error("cannot resize \"" + m_path + "\"");
+#endif
+	m_size = size;
+}
+
+/// <summary>
+/// Map a view of the file
+/// </summary>
+/// <param name="offset"></param>
+/// <param name="length"></param>
+/// <param name="writable"></param>
+/// <returns></returns>
+void* MappedFile::Map(uint64_t offset, size_t length, bool writable)
+{
+	if (offset + length > m_size)
+		throw std::out_of_range("view beyond end of \"" + m_path + "\"");
+#if defined(_WIN32)
+	uint64_t end = offset + length;
+	HANDLE mapping = CreateFileMappingA(m_file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+		static_cast<DWORD>(end >> 32), static_cast<DWORD>(end), nullptr);
+	if (mapping == nullptr)
+		throw std::runtime_error("cannot map \"" + m_path + "\"");
+	void* view = MapViewOfFile(mapping, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ,
+		static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), length);
+	CloseHandle(mapping);	// The view keeps the mapping alive
+	if (view == nullptr)
+		throw std::runtime_error("cannot map \"" + m_path + "\"");
+	return view;
+#else
+	void* view = mmap(nullptr, length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m_file, static_cast<off_t>(offset));
+	if (view == MAP_FAILED)
+		throw std::runtime_error("cannot map \"" + m_path + "\"");
+	return view;
+#endif
+}
+
+/// <summary>
+/// Unmap a view
+/// </summary>
+/// <param name="view"></param>
+/// <param name="length"></param>
+void MappedFile::Unmap(void* view, size_t length)
+{
+	if (view == nullptr)
+		return;
+#if defined(_WIN32)
+	UnmapViewOfFile(view);
+#else
+	munmap(view, length);
+#endif
+}
+
+/// <summary>
+/// Drop a view from the resident set. Dirty pages are written to the file
+/// first, the next access faults them back in.
+/// </summary>
+/// <param name="view"></param>
+/// <param name="length"></param>
+void MappedFile::Evict(void* view, size_t length)
+{
+#if defined(_WIN32)
+	FlushViewOfFile(view, length);
+	VirtualUnlock(view, length);	// Unlocking unlocked pages removes them from the working set
+#else
+	msync(view, length, MS_ASYNC);
+#if defined(MADV_PAGEOUT)
+	if (madvise(view, length, MADV_PAGEOUT) == 0)
+		return;
+#endif
+	madvise(view, length, MADV_DONTNEED);
+#endif
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// File that is grown on demand and mapped in to memory in separate views.
+/// Views stay valid while the file grows, so pointers in to them are stable.
+/// </summary>
+class MappedFile
+{
+	private:
+
+#if defined(_WIN32)
+		void* m_file = nullptr;
+#else
+		int m_file = -1;
+#endif
+		std::string m_path;
+		uint64_t m_size = 0;
+
+	public:
+
+		// Views must start on a multiple of this
+		static size_t Granularity();
+
+		MappedFile() {}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		virtual ~MappedFile();
+
+		// Create (truncate) a file. A scratch file is removed from the file system once closed
+		void Create(const std::string& path, bool scratch);
+		// Open an existing file for reading
+		void OpenReadOnly(const std::string& path);
+		void Close();
+
+		inline bool IsOpen() const
+		{
+#if defined(_WIN32)
+			return m_file != nullptr;
+#else
+			return m_file >= 0;
+#endif
+		}
+
+		inline uint64_t Size() const
+		{
+			return m_size;
+		}
+
+		inline const std::string& Path() const
+		{
+			return m_path;
+		}
+
+		void Resize(uint64_t size);
+
+		// Map length bytes at offset, offset must be a multiple of Granularity()
+		void* Map(uint64_t offset, size_t length, bool writable = true);
+		static void Unmap(void* view, size_t length);
+		// Write a view back and drop it from the resident set, the data stays in the file
+		static void Evict(void* view, size_t length);
+};
@@ -0,0 +1,92 @@
+
+#include <sstream>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "MemoryBudget.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="limitBytes"></param>
+/// <param name="policy"></param>
+/// <param name="checkInterval"></param>
+MemoryBudget::MemoryBudget(size_t limitBytes, Policy policy, size_t checkInterval) : m_limit(limitBytes), m_policy(policy), m_checkInterval(checkInterval)
+{
+	if (limitBytes == 0)
+		throw std::invalid_argument("memory limit cannot be 0");
+	if (m_policy == Policy::Spill)
+		m_spillPath = "cgl_spill.tiles";
+	if (m_checkInterval == 0)
+		m_checkInterval = 1;
+}
+
+/// <summary>
+/// Rebuild the report and return its total
+/// </summary>
+/// <param name="board"></param>
+/// <param name="engine"></param>
+/// <returns></returns>
+size_t MemoryBudget::Measure(const Board& board, const Board::Visitor* engine)
+{
+	m_report.Clear();
+	board.ReportMemory(m_report);
+	if (engine != nullptr)
+		engine->ReportMemory(m_report);
+	size_t total = m_report.TotalBytes();
+	if (total > m_peak)
+		m_peak = total;
+	return total;
+}
+
+/// <summary>
+/// Compact the board, drop engine scratch and hand freed pages back to the OS
+/// </summary>
+/// <param name="board"></param>
+/// <param name="engine"></param>
+void MemoryBudget::Compact(Board& board, Board::Visitor* engine)
+{
+	board.Compact();
+	if (engine != nullptr)
+		engine->ReleaseMemory();
+#if defined(__GLIBC__)
+	malloc_trim(0);
+#endif
+	++m_compactions;
+}
+
+/// <summary>
+/// Measure and enforce the budget
+/// </summary>
+/// <param name="board"></param>
+/// <param name="engine"></param>
+void MemoryBudget::Check(Board& board, Board::Visitor* engine)
+{
+	if (m_generation++ % m_checkInterval != 0)
+		return;
+
+	size_t total = Measure(board, engine);
+	size_t highWater = m_limit / 100 * HIGH_WATER_PERCENT;
+	if (m_policy != Policy::Abort && total >= highWater)
+	{
+		Compact(board, engine);
+		total = Measure(board, engine);
+	}
+	if (m_policy == Policy::Spill && total >= highWater && !board.IsPaged())
+	{
+		if (m_spillPath.empty())
+			throw std::logic_error("spill policy needs a spill file");
+		board.UsePagedStorage(m_spillPath, m_limit / 4);	// Tiles count against the budget while mapped in
+		total = Measure(board, engine);
+	}
+	if (total > m_limit)
+	{
+		std::ostringstream out;
+		out << "memory budget of " << m_limit << " bytes exceeded at generation " << m_generation - 1
+			<< " (" << total << " bytes, " << board.Size() << " cells)\n";
+		m_report.Print(out);
+		throw MemoryBudgetExceeded(out.str());
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#include "Board.h"
+#include "MemoryUsage.h"
+
+/// <summary>
+/// Thrown when a simulation cannot be kept within its memory budget.
+/// what() holds the memory report at the time of the failure.
+/// </summary>
+class MemoryBudgetExceeded : public std::runtime_error
+{
+	public:
+		MemoryBudgetExceeded(const std::string& report) : std::runtime_error(report) {}
+};
+
+/// <summary>
+/// Hard memory budget for a board and its update engine. Checked between
+/// generations; when usage reaches the high water mark the policy decides
+/// what happens, and going over the limit always ends the run with a report.
+/// </summary>
+class MemoryBudget
+{
+	public:
+
+		enum class Policy
+		{
+			Abort,		// Stop with a report once over the limit
+			Compact,	// Rebuild structures and drop engine scratch above the high water mark
+			Spill		// Compact, then move the board to file backed tiles above the high water mark
+		};
+
+	private:
+
+		static const size_t HIGH_WATER_PERCENT = 90;
+
+		size_t m_limit = 0;
+		Policy m_policy = Policy::Abort;
+		size_t m_checkInterval = 1;
+		size_t m_generation = 0;
+		size_t m_peak = 0;
+		size_t m_compactions = 0;
+		std::string m_spillPath;
+		MemoryReport m_report;
+
+		size_t Measure(const Board& board, const Board::Visitor* engine);
+		void Compact(Board& board, Board::Visitor* engine);
+
+	public:
+
+		// checkInterval: generations between measurements, a measurement walks all structures
+		MemoryBudget(size_t limitBytes, Policy policy, size_t checkInterval = 1);
+
+		// Scratch file used by the Spill policy
+		inline void SetSpillPath(const std::string& path)
+		{
+			m_spillPath = path;
+		}
+
+		// Call once per generation, throws MemoryBudgetExceeded if over the limit
+		void Check(Board& board, Board::Visitor* engine);
+
+		inline size_t PeakBytes() const
+		{
+			return m_peak;
+		}
+
+		inline size_t Compactions() const
+		{
+			return m_compactions;
+		}
+
+		// Report of the last measurement
+		inline const MemoryReport& LastReport() const
+		{
+			return m_report;
+		}
+};
@@ -0,0 +1,159 @@
+
+#include <fstream>
+#include <iomanip>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "MemoryUsage.h"
+
+/// <summary>
+/// Accumulate
+/// </summary>
+/// <param name="other"></param>
+/// <returns></returns>
+MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other)
+{
+	m_nodes += other.m_nodes;
+	m_bytes += other.m_bytes;
+	m_payload += other.m_payload;
+	return *this;
+}
+
+/// <summary>
+/// Fraction of the estimated bytes that do not hold payload. For the node
+/// based containers used here this is the price of links, padding and the
+/// allocator's per block header, i.e. the fragmentation of the representation.
+/// </summary>
+/// <returns></returns>
+double MemoryUsage::Overhead() const
+{
+	if (m_bytes == 0)
+		return 0.0;
+	return 1.0 - static_cast<double>(m_payload) / static_cast<double>(m_bytes);
+}
+
+/// <summary>
+/// Estimated size of one heap block: a pointer sized header, rounded up to
+/// the two pointer alignment common to the MSVC and glibc heaps.
+/// </summary>
+/// <param name="size"></param>
+/// <returns></returns>
+size_t MemoryUsage::BlockBytes(size_t size)
+{
+	const size_t align = 2 * sizeof(void*);
+	size_t raw = size + sizeof(void*);
+	return (raw + align - 1) / align * align;
+}
+
+/// <summary>
+/// Add plain heap blocks
+/// </summary>
+/// <param name="count"></param>
+/// <param name="size"></param>
+/// <param name="payload">:total payload bytes in all blocks</param>
+void MemoryUsage::AddBlocks(size_t count, size_t size, size_t payload)
+{
+	if (count == 0)
+		return;
+	m_nodes += count;
+	m_bytes += count * BlockBytes(size);
+	m_payload += payload;
+}
+
+/// <summary>
+/// Add tree or list nodes. std::map/std::set nodes carry three links and a
+/// colour next to the value, std::list nodes two links; using the larger one
+/// keeps the estimate on the safe side.
+/// </summary>
+/// <param name="count"></param>
+/// <param name="valueSize"></param>
+/// <param name="payload">:total payload bytes in all nodes</param>
+void MemoryUsage::AddNodes(size_t count, size_t valueSize, size_t payload)
+{
+	AddBlocks(count, 4 * sizeof(void*) + valueSize, payload);
+}
+
+/// <summary>
+/// Add a named entry
+/// </summary>
+/// <param name="name"></param>
+/// <param name="usage"></param>
+void MemoryReport::Add(const std::string& name, const MemoryUsage& usage)
+{
+	Entry entry;
+	entry.m_name = name;
+	entry.m_usage = usage;
+	m_entries.push_back(entry);
+}
+
+/// <summary>
+/// Sum of all entries
+/// </summary>
+/// <returns></returns>
+size_t MemoryReport::TotalBytes() const
+{
+	size_t total = 0;
+	for (const auto& e : m_entries)
+		total += e.m_usage.m_bytes;
+	return total;
+}
+
+/// <summary>
+/// Print a table of all entries, the total and the process resident size.
+/// Resident memory not accounted for is allocator free lists, fragmentation
+/// and everything outside the simulation structures.
+/// </summary>
+/// <param name="out"></param>
+void MemoryReport::Print(std::ostream& out) const
+{
+	out << std::left << std::setw(28) << "#structure" << std::right
+		<< std::setw(12) << "nodes" << std::setw(16) << "bytes" << std::setw(16) << "payload" << std::setw(10) << "overhead" << '\n';
+	MemoryUsage total;
+	for (const auto& e : m_entries)
+	{
+		out << std::left << std::setw(28) << e.m_name << std::right
+			<< std::setw(12) << e.m_usage.m_nodes << std::setw(16) << e.m_usage.m_bytes << std::setw(16) << e.m_usage.m_payload
+			<< std::setw(9) << std::fixed << std::setprecision(1) << e.m_usage.Overhead() * 100.0 << "%\n";
+		total += e.m_usage;
+	}
+	out << std::left << std::setw(28) << "total" << std::right
+		<< std::setw(12) << total.m_nodes << std::setw(16) << total.m_bytes << std::setw(16) << total.m_payload
+		<< std::setw(9) << std::fixed << std::setprecision(1) << total.Overhead() * 100.0 << "%\n";
+
+	size_t resident = ProcessResidentBytes();
+	if (resident != 0)
+	{
+		out << std::left << std::setw(28) << "process resident" << std::right << std::setw(28) << resident << '\n';
+		out << std::left << std::setw(28) << "unaccounted" << std::right << std::setw(28)
+			<< (resident > total.m_bytes ? resident - total.m_bytes : 0) << '\n';
+	}
+}
+
+/// <summary>
+/// Resident set size of the process
+/// </summary>
+/// <returns>bytes, 0 if not available on this platform</returns>
+size_t MemoryReport::ProcessResidentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#elif defined(__linux__)
+	std::ifstream statm("/proc/self/statm");
+	size_t pages = 0, resident = 0;
+	if (statm >> pages >> resident)
+		return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	return 0;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Estimated heap use of one structure
+/// </summary>
+struct MemoryUsage
+{
+	size_t m_nodes = 0;		// Heap allocations
+	size_t m_bytes = 0;		// Estimated bytes, including links, padding and allocator headers
+	size_t m_payload = 0;	// Bytes of keys and values actually held
+
+	MemoryUsage& operator+=(const MemoryUsage& other);
+
+	// Fraction of m_bytes not holding payload
+	double Overhead() const;
+
+	// Add count allocations of size bytes each
+	void AddBlocks(size_t count, size_t size, size_t payload);
+	// Add count tree or list nodes holding a value of valueSize bytes
+	void AddNodes(size_t count, size_t valueSize, size_t payload);
+
+	// Estimated bytes the heap uses for one allocation of size bytes
+	static size_t BlockBytes(size_t size);
+};
+
+/// <summary>
+/// Named memory usage of all structures of a simulation
+/// </summary>
+class MemoryReport
+{
+	private:
+
+		struct Entry
+		{
+			std::string m_name;
+			MemoryUsage m_usage;
+		};
+
+		std::vector<Entry> m_entries;
+
+	public:
+
+		inline void Clear()
+		{
+			m_entries.clear();
+		}
+
+		void Add(const std::string& name, const MemoryUsage& usage);
+		size_t TotalBytes() const;
+		void Print(std::ostream& out) const;
+
+		// Resident memory of the whole process, 0 if not available
+		static size_t ProcessResidentBytes();
+};
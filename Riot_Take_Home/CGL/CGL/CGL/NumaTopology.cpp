@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "NumaTopology.h"
+
+/// <summary>
+/// ctor, detects the topology
+/// </summary>
+NumaTopology::NumaTopology()
+{
+#if defined(__linux__)
+	const std::string root = "/sys/devices/system/node/";
+	if (DIR* dir = opendir(root.c_str()))
+	{
+		while (dirent* entry = readdir(dir))
+		{
+			std::string name = entry->d_name;
+			if (name.compare(0, 4, "node") != 0 || name.size() == 4 || name.find_first_not_of("0123456789", 4) != std::string::npos)
+				continue;
+
+			std::ifstream file(root + name + "/cpulist");
+			std::string list;
+			Node node;
+			node.m_id = std::stoi(name.substr(4));
+			if (std::getline(file, list) && ParseCpuList(list, node.m_cpus) && !node.m_cpus.empty())
+				m_nodes.push_back(node);
+		}
+		closedir(dir);
+	}
+	std::sort(m_nodes.begin(), m_nodes.end(), [](const Node& a, const Node& b) { return a.m_id < b.m_id; });
+#endif
+
+	if (m_nodes.empty())
+	{
+		Node node;
+		unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned cpu = 0; cpu < cpus; ++cpu)
+			node.m_cpus.push_back((int)cpu);
+		m_nodes.push_back(node);
+	}
+}
+
+/// <summary>
+/// Parse a kernel cpu list such as "0-3,8,10-11"
+/// </summary>
+/// <param name="list"></param>
+/// <param name="cpus"></param>
+/// <returns>false if the list is malformed</returns>
+bool NumaTopology::ParseCpuList(const std::string& list, std::vector<int>& cpus)
+{
+	std::stringstream in(list);
+	std::string range;
+	while (std::getline(in, range, ','))
+	{
+		if (range.empty() || range == "\n")
+			continue;
+		try
+		{
+			size_t dash = range.find('-');
+			int first = std::stoi(range.substr(0, dash));
+			int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+			for (int cpu = first; cpu <= last; ++cpu)
+				cpus.push_back(cpu);
+		}
+		catch (const std::exception&)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Number of CPUs on all nodes
+/// </summary>
+/// <returns></returns>
+size_t NumaTopology::CpuCount() const
+{
+	size_t count = 0;
+	for (const auto& node : m_nodes)
+		count += node.m_cpus.size();
+	return count;
+}
+
+/// <summary>
+/// Pin the calling thread
+/// </summary>
+/// <param name="cpu"></param>
+/// <returns></returns>
+bool NumaTopology::PinCurrentThread(int cpu)
+{
+#if defined(_WIN32)
+	if (cpu < 0 || cpu >= 64)
+		return false;
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// NUMA nodes of the machine and the CPUs on each. Read from
+/// /sys/devices/system/node on Linux; elsewhere, or without that directory,
+/// all CPUs are reported as one node.
+/// </summary>
+class NumaTopology
+{
+	public:
+
+		struct Node
+		{
+			int m_id = 0;
+			std::vector<int> m_cpus;
+		};
+
+	private:
+
+		std::vector<Node> m_nodes;
+
+		static bool ParseCpuList(const std::string& list, std::vector<int>& cpus);
+
+	public:
+
+		NumaTopology();
+
+		inline const std::vector<Node>& Nodes() const
+		{
+			return m_nodes;
+		}
+
+		size_t CpuCount() const;
+
+		// Restrict the calling thread to one CPU. Returns false if the platform does not allow it
+		static bool PinCurrentThread(int cpu);
+};
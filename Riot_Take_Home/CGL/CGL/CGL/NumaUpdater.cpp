@@ -0,0 +1,320 @@
+#include "NumaUpdater.h"
+
+/// <summary>
+/// ctor, starts the workers. Worker i is placed on node i modulo the node
+/// count, so any number of workers is spread evenly over the nodes
+/// </summary>
+/// <param name="numThreads">:0 for one worker per CPU</param>
+NumaUpdater::NumaUpdater(size_t numThreads)
+{
+	const std::vector<NumaTopology::Node>& nodes = m_topology.Nodes();
+	if (numThreads == 0)
+		numThreads = m_topology.CpuCount();
+
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		m_workers.emplace_back(new Worker());
+		Worker& worker = *m_workers.back();
+		worker.m_node = i % nodes.size();
+		const std::vector<int>& cpus = nodes[worker.m_node].m_cpus;
+		worker.m_cpu = cpus[(i / nodes.size()) % cpus.size()];
+	}
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		for (size_t sameNode = 0; sameNode < 2; ++sameNode)
+		{
+			for (size_t step = 1; step < numThreads; ++step)
+			{
+				size_t victim = (i + step) % numThreads;
+				if ((m_workers[victim]->m_node == m_workers[i]->m_node) == (sameNode == 0))
+					m_workers[i]->m_victims.push_back(victim);
+			}
+		}
+	}
+	for (size_t i = 0; i < numThreads; ++i)
+		m_workers[i]->m_thread = std::thread(&NumaUpdater::WorkerLoop, this, i);
+}
+
+/// <summary>
+/// dtor, stops the workers
+/// </summary>
+NumaUpdater::~NumaUpdater()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_phase = Phase::Stop;
+		++m_round;
+	}
+	m_start.notify_all();
+	for (auto& worker : m_workers)
+		worker->m_thread.join();
+}
+
+/// <summary>
+/// Worker owning the region of a tile
+/// </summary>
+/// <param name="tile"></param>
+/// <returns></returns>
+size_t NumaUpdater::Owner(const TileKey& tile) const
+{
+	return (size_t)(BoardState::HashCell(tile.m_row >> REGION_SHIFT, tile.m_col >> REGION_SHIFT) % m_workers.size());
+}
+
+/// <summary>
+/// Tile from its owner's map, 0 if it has no live cells
+/// </summary>
+/// <param name="tile"></param>
+/// <returns></returns>
+uint64_t NumaUpdater::GetTile(const TileKey& tile) const
+{
+	const Tiles& tiles = m_workers[Owner(tile)]->m_tiles;
+	auto it = tiles.find(tile);
+	return it == tiles.end() ? 0 : it->second;
+}
+
+/// <summary>
+/// A tile and its neighbours, [row + 1][col + 1], 0 past the edges of the plane
+/// </summary>
+/// <param name="key"></param>
+/// <param name="around"></param>
+void NumaUpdater::Gather(const TileKey& key, uint64_t (&around)[3][3]) const
+{
+	for (int dr = -1; dr <= 1; ++dr)
+		for (int dc = -1; dc <= 1; ++dc)
+			around[dr + 1][dc + 1] = HasNeighbourTile(key, dr, dc) ? GetTile(TileKey(key.m_row + dr, key.m_col + dc)) : 0;
+}
+
+/// <summary>
+/// Build phase, on the worker's thread: tiles of the owned cells, grouped by region
+/// </summary>
+/// <param name="worker"></param>
+void NumaUpdater::Build(Worker& worker)
+{
+	worker.m_tiles.clear();
+	for (const auto& cell : worker.m_cells)
+		worker.m_tiles[TileKey(cell.m_row >> TILE_SHIFT, cell.m_col >> TILE_SHIFT)] |= 1ULL << ((cell.m_row & TILE_MASK) * 8 + (cell.m_col & TILE_MASK));
+	worker.m_cells.clear();
+
+	worker.m_regionIndex.clear();
+	worker.m_regionCount = 0;
+	for (const auto& tile : worker.m_tiles)
+	{
+		TileKey region(tile.first.m_row >> REGION_SHIFT, tile.first.m_col >> REGION_SHIFT);
+		auto inserted = worker.m_regionIndex.emplace(region, worker.m_regionCount);
+		if (inserted.second)
+		{
+			if (worker.m_regions.size() <= worker.m_regionCount)
+				worker.m_regions.emplace_back();
+			worker.m_regions[worker.m_regionCount++].clear();
+		}
+		worker.m_regions[inserted.first->second].push_back(tile.first);
+	}
+
+	std::lock_guard<std::mutex> lock(worker.m_queueLock);
+	worker.m_queueHead = 0;
+	worker.m_queueTail = worker.m_regionCount;
+}
+
+/// <summary>
+/// Step the live tiles of one region and the empty tiles next to them. An
+/// empty tile is stepped with the first of its live neighbours in scan order,
+/// so it is stepped once however many regions and workers surround it.
+/// </summary>
+/// <param name="owner">:worker owning the region</param>
+/// <param name="region">:index of the region in the owner</param>
+/// <param name="worker">:worker doing the step, collects the changes</param>
+void NumaUpdater::StepRegion(const Worker& owner, size_t region, Worker& worker)
+{
+	auto collect = [&worker](int64_t row, int64_t col) { worker.m_changes.emplace_back(row, col); };
+
+	uint64_t around[3][3];
+	uint64_t aroundEmpty[3][3];
+	for (const TileKey& key : owner.m_regions[region])
+	{
+		Gather(key, around);
+		ForEachTileCell(key, around[1][1] ^ StepTile<Table>(around), collect);
+
+		for (int dr = -1; dr <= 1; ++dr)
+		{
+			for (int dc = -1; dc <= 1; ++dc)
+			{
+				if (around[dr + 1][dc + 1] != 0 || !HasNeighbourTile(key, dr, dc))
+					continue;
+				TileKey empty(key.m_row + dr, key.m_col + dc);
+				Gather(empty, aroundEmpty);
+
+				// This tile sits at [1 - dr][1 - dc] seen from the empty one
+				int first = 0;
+				while (aroundEmpty[first / 3][first % 3] == 0)
+					++first;
+				if (first == (1 - dr) * 3 + (1 - dc))
+					ForEachTileCell(empty, StepTile<Table>(aroundEmpty), collect);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Take a region from a worker's queue. The owner takes from the front, thieves from the back
+/// </summary>
+/// <param name="victim"></param>
+/// <param name="own">:true if the caller owns the queue</param>
+/// <param name="region"></param>
+/// <returns>false if the queue is empty</returns>
+bool NumaUpdater::TakeRegion(Worker& victim, bool own, size_t& region)
+{
+	std::lock_guard<std::mutex> lock(victim.m_queueLock);
+	if (victim.m_queueHead == victim.m_queueTail)
+		return false;
+	region = own ? victim.m_queueHead++ : --victim.m_queueTail;
+	return true;
+}
+
+/// <summary>
+/// Step phase: own regions first, then regions stolen from the victims in order
+/// </summary>
+/// <param name="worker"></param>
+void NumaUpdater::Step(Worker& worker)
+{
+	worker.m_changes.clear();
+	size_t region = 0;
+	while (TakeRegion(worker, true, region))
+		StepRegion(worker, region, worker);
+	for (size_t victim : worker.m_victims)
+	{
+		Worker& owner = *m_workers[victim];
+		while (TakeRegion(owner, false, region))
+			StepRegion(owner, region, worker);
+	}
+}
+
+/// <summary>
+/// Worker thread: pin, then run each phase the updater starts
+/// </summary>
+/// <param name="index"></param>
+void NumaUpdater::WorkerLoop(size_t index)
+{
+	Worker& worker = *m_workers[index];
+	NumaTopology::PinCurrentThread(worker.m_cpu);
+
+	uint64_t seen = 0;
+	for (;;)
+	{
+		Phase phase;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_start.wait(lock, [this, seen]() { return m_round != seen; });
+			seen = m_round;
+			phase = m_phase;
+		}
+		if (phase == Phase::Stop)
+			return;
+
+		try
+		{
+			if (phase == Phase::Build)
+				Build(worker);
+			else if (phase == Phase::Step)
+				Step(worker);
+			else if (phase == Phase::Release)
+			{
+				Tiles().swap(worker.m_tiles);
+				std::unordered_map<TileKey, size_t, TileKeyHash>().swap(worker.m_regionIndex);
+				std::vector<std::vector<TileKey>>().swap(worker.m_regions);
+				std::vector<BoardState::Cell>().swap(worker.m_changes);
+				std::vector<BoardState::Cell>().swap(worker.m_cells);
+				worker.m_regionCount = 0;
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			if (!m_error)
+				m_error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (--m_pending == 0)
+			m_done.notify_one();
+	}
+}
+
+/// <summary>
+/// Run a phase on all workers and wait for them
+/// </summary>
+/// <param name="phase"></param>
+void NumaUpdater::RunPhase(Phase phase)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_phase = phase;
+		m_pending = m_workers.size();
+		++m_round;
+	}
+	m_start.notify_all();
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_done.wait(lock, [this]() { return m_pending == 0; });
+	if (m_error)
+	{
+		std::exception_ptr error = m_error;
+		m_error = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+/// <summary>
+/// Hand the live cell to the worker owning its region
+/// </summary>
+/// <param name="board"></param>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns></returns>
+bool NumaUpdater::Visit(Board& board, int64_t row, int64_t col)
+{
+	m_workers[Owner(TileKey(row >> TILE_SHIFT, col >> TILE_SHIFT))]->m_cells.emplace_back(row, col);
+	return true;
+}
+
+/// <summary>
+/// Build and step all regions on the workers, then apply the changes
+/// </summary>
+/// <param name="board"></param>
+void NumaUpdater::OnEnded(Board& board)
+{
+	RunPhase(Phase::Build);
+	RunPhase(Phase::Step);
+	for (const auto& worker : m_workers)
+		for (const auto& cell : worker->m_changes)
+			board.QueueToggle(cell.m_row, cell.m_col);
+	board.ApplyToggles();
+}
+
+/// <summary>
+/// Add the workers' tiles to a memory report
+/// </summary>
+/// <param name="report"></param>
+void NumaUpdater::ReportMemory(MemoryReport& report) const
+{
+	MemoryUsage tiles;
+	MemoryUsage buffers;
+	for (const auto& worker : m_workers)
+	{
+		tiles.AddNodes(worker->m_tiles.size(), sizeof(Tiles::value_type), worker->m_tiles.size() * sizeof(Tiles::value_type));
+		tiles.AddBlocks(1, worker->m_tiles.bucket_count() * sizeof(void*), 0);
+		for (const auto& region : worker->m_regions)
+			buffers.AddBlocks(1, region.capacity() * sizeof(TileKey), region.size() * sizeof(TileKey));
+		buffers.AddBlocks(1, worker->m_cells.capacity() * sizeof(BoardState::Cell), worker->m_cells.size() * sizeof(BoardState::Cell));
+		buffers.AddBlocks(1, worker->m_changes.capacity() * sizeof(BoardState::Cell), worker->m_changes.size() * sizeof(BoardState::Cell));
+	}
+	report.Add("numa tiles", tiles);
+	report.Add("numa buffers", buffers);
+}
+
+/// <summary>
+/// Each worker frees its own structures
+/// </summary>
+void NumaUpdater::ReleaseMemory()
+{
+	RunPhase(Phase::Release);
+}
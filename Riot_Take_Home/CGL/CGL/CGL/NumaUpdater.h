@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "BlockTable.h"
+#include "Board.h"
+#include "LifeTile.h"
+#include "NumaTopology.h"
+
+/// <summary>
+/// NumaUpdater - multi threaded visitor used to update the game of life on
+/// machines with several NUMA nodes.
+/// The plane is cut in to regions of 16x16 tiles of 8x8 cells, and every
+/// region is owned by one of a set of worker threads pinned to CPUs spread
+/// over the nodes. Workers build their regions' tiles themselves, so the
+/// memory is first touched, and placed, on the owner's node. Regions are then
+/// stepped with the lookup table kernel; a worker that runs out of its own
+/// regions steals from workers on its node before it steals across nodes.
+/// </summary>
+class NumaUpdater final : public Board::StaticVisitor<NumaUpdater>
+{
+	typedef BlockTable<CONWAY_BIRTH, CONWAY_SURVIVE> Table;
+	typedef std::unordered_map<TileKey, uint64_t, TileKeyHash> Tiles;
+
+	const static int REGION_SHIFT = 4;
+
+	enum class Phase
+	{
+		Build,
+		Step,
+		Release,
+		Stop
+	};
+
+	/// <summary>
+	/// One pinned thread and the regions it owns
+	/// </summary>
+	struct Worker
+	{
+		std::thread m_thread;
+		int m_cpu = 0;
+		size_t m_node = 0;
+		std::vector<size_t> m_victims;			// Workers to steal from, same node first
+		std::vector<BoardState::Cell> m_cells;	// Live cells of owned regions, filled by Visit
+		Tiles m_tiles;
+		std::unordered_map<TileKey, size_t, TileKeyHash> m_regionIndex;
+		std::vector<std::vector<TileKey>> m_regions;	// Live tiles of each owned region
+		size_t m_regionCount = 0;
+		std::mutex m_queueLock;
+		size_t m_queueHead = 0;					// Regions [head, tail) are not stepped yet
+		size_t m_queueTail = 0;
+		std::vector<BoardState::Cell> m_changes;	// Cells toggled by regions this worker stepped
+	};
+
+	NumaTopology m_topology;
+	std::vector<std::unique_ptr<Worker>> m_workers;
+
+	std::mutex m_lock;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+	uint64_t m_round = 0;
+	size_t m_pending = 0;
+	Phase m_phase = Phase::Build;
+	std::exception_ptr m_error;
+
+	size_t Owner(const TileKey& tile) const;
+	uint64_t GetTile(const TileKey& tile) const;
+	void Gather(const TileKey& key, uint64_t (&around)[3][3]) const;
+	void Build(Worker& worker);
+	void StepRegion(const Worker& owner, size_t region, Worker& worker);
+	void Step(Worker& worker);
+	bool TakeRegion(Worker& victim, bool own, size_t& region);
+	void WorkerLoop(size_t index);
+	void RunPhase(Phase phase);
+
+public:
+
+	// numThreads: 0 for one worker per CPU
+	NumaUpdater(size_t numThreads = 0);
+	virtual ~NumaUpdater();
+
+	bool Visit(Board& board, int64_t row, int64_t col) override;
+	void OnEnded(Board& board) override;
+	void ReportMemory(MemoryReport& report) const override;
+	void ReleaseMemory() override;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Run f(begin, end, worker) over [0, count) split in to one contiguous range
+/// per worker thread. The calling thread runs the first range. The first
+/// exception thrown by any worker is rethrown once all workers are done.
+/// </summary>
+/// <param name="count"></param>
+/// <param name="numThreads">:0 for hardware concurrency</param>
+/// <param name="f"></param>
+template <typename F>
+void ParallelFor(size_t count, size_t numThreads, F f)
+{
+	if (numThreads == 0)
+		numThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	numThreads = std::max<size_t>(1, std::min(numThreads, count));
+
+	std::exception_ptr error;
+	std::mutex errorLock;
+	auto run = [&](size_t worker)
+	{
+		size_t begin = count * worker / numThreads;
+		size_t end = count * (worker + 1) / numThreads;
+		try
+		{
+			f(begin, end, worker);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(errorLock);
+			if (!error)
+				error = std::current_exception();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < numThreads; ++t)
+		threads.emplace_back(run, t);
+	run(0);
+	for (auto& t : threads)
+		t.join();
+	if (error)
+		std::rethrow_exception(error);
+}
+
+/// <summary>
+/// Run f(index, worker) for every index in [0, count), handing out indices one
+/// at a time so uneven items balance across the workers. Exceptions are
+/// handled as in ParallelFor.
+/// </summary>
+/// <param name="count"></param>
+/// <param name="numThreads">:0 for hardware concurrency</param>
+/// <param name="f"></param>
+template <typename F>
+void ParallelForEach(size_t count, size_t numThreads, F f)
+{
+	std::atomic<size_t> next(0);
+	ParallelFor(count, numThreads, [&](size_t, size_t, size_t worker)
+	{
+		for (size_t i = next++; i < count; i = next++)
+			f(i, worker);
+	});
+}
@@ -0,0 +1,273 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "PerfCounters.h"
+
+const char* const PerfCounters::EVENT_NAMES[EVENT_COUNT] =
+{
+	"cycles",
+	"instructions",
+	"l1d-misses",
+	"llc-misses",
+	"branch-misses",
+};
+
+namespace
+{
+	double Now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+#if defined(__linux__)
+	int OpenEvent(uint32_t type, uint64_t config, int group)
+	{
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.disabled = group < 0 ? 1 : 0;
+		return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+	}
+
+	uint64_t CacheMiss(uint64_t cache)
+	{
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	}
+#endif
+}
+
+/// <summary>
+/// Add another sample's values
+/// </summary>
+/// <param name="other"></param>
+/// <returns></returns>
+PerfCounters::Sample& PerfCounters::Sample::operator+=(const Sample& other)
+{
+	for (size_t e = 0; e < EVENT_COUNT; ++e)
+	{
+		m_values[e] += other.m_values[e];
+		m_valid[e] = other.m_valid[e];
+	}
+	m_seconds += other.m_seconds;
+	return *this;
+}
+
+/// <summary>
+/// Difference of two cumulative samples
+/// </summary>
+/// <param name="other">:the earlier sample</param>
+/// <returns></returns>
+PerfCounters::Sample PerfCounters::Sample::operator-(const Sample& other) const
+{
+	Sample result;
+	for (size_t e = 0; e < EVENT_COUNT; ++e)
+	{
+		result.m_valid[e] = m_valid[e] && other.m_valid[e];
+		result.m_values[e] = result.m_valid[e] && m_values[e] > other.m_values[e] ? m_values[e] - other.m_values[e] : 0;
+	}
+	result.m_seconds = m_seconds - other.m_seconds;
+	return result;
+}
+
+/// <summary>
+/// ctor. All events go in one group, so they are scheduled together
+/// </summary>
+PerfCounters::PerfCounters()
+{
+	for (size_t e = 0; e < EVENT_COUNT; ++e)
+	{
+		m_fds[e] = -1;
+		m_slots[e] = 0;
+	}
+
+#if defined(__linux__)
+	const uint32_t types[EVENT_COUNT] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+	const uint64_t configs[EVENT_COUNT] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		CacheMiss(PERF_COUNT_HW_CACHE_L1D),
+		CacheMiss(PERF_COUNT_HW_CACHE_LL),
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+
+	// The first event the CPU provides leads the group
+	for (size_t e = 0; e < EVENT_COUNT; ++e)
+	{
+		m_fds[e] = OpenEvent(types[e], configs[e], m_leader);
+		if (m_fds[e] < 0)
+		{
+			if (m_error.empty())
+				m_error = std::string("perf_event_open failed for ") + EVENT_NAMES[e] + ": " + std::strerror(errno);
+			continue;
+		}
+		if (m_leader < 0)
+			m_leader = m_fds[e];
+		m_slots[e] = m_opened++;
+	}
+	if (m_leader < 0)
+	{
+		m_error += " (check /proc/sys/kernel/perf_event_paranoid)";
+		return;
+	}
+	ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+	m_error = "hardware counters need Linux perf_event_open";
+#endif
+}
+
+/// <summary>
+/// dtor
+/// </summary>
+PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+	for (size_t e = 0; e < EVENT_COUNT; ++e)
+		if (m_fds[e] >= 0)
+			close(m_fds[e]);
+#endif
+}
+
+/// <summary>
+/// Read all counters with one system call
+/// </summary>
+/// <returns></returns>
+PerfCounters::Sample PerfCounters::Read() const
+{
+	Sample sample;
+	sample.m_seconds = Now();
+#if defined(__linux__)
+	if (m_leader < 0)
+		return sample;
+
+	// nr, time enabled, time running, then one value per opened event
+	uint64_t data[3 + EVENT_COUNT] = {};
+	ssize_t bytes = read(m_leader, data, sizeof(data));
+	if (bytes < (ssize_t)(3 * sizeof(uint64_t)) || data[2] == 0)
+		return sample;
+
+	double scale = (double)data[1] / (double)data[2];
+	for (size_t e = 0; e < EVENT_COUNT; ++e)
+	{
+		if (m_fds[e] < 0 || m_slots[e] >= data[0])
+			continue;
+		sample.m_valid[e] = true;
+		sample.m_values[e] = (uint64_t)((double)data[3 + m_slots[e]] * scale);
+	}
+#endif
+	return sample;
+}
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="out">:stream for the per generation lines</param>
+PhaseProfiler::PhaseProfiler(std::ostream& out) : m_out(out)
+{
+	if (!m_counters.IsAvailable())
+		m_out << "#P no hardware counters, timing only: " << m_counters.Error() << '\n';
+	m_out << "#P generation phase seconds";
+	for (size_t e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+		m_out << ' ' << PerfCounters::EVENT_NAMES[e];
+	m_out << '\n';
+}
+
+/// <summary>
+/// Close the running phase, adding its counts
+/// </summary>
+void PhaseProfiler::EndPhase()
+{
+	PerfCounters::Sample now = m_counters.Read();
+	m_phases[m_phase] += now - m_mark;
+	m_mark = now;
+}
+
+/// <summary>
+/// Start counting an update, which begins with neighbour evaluation
+/// </summary>
+void PhaseProfiler::BeginGeneration()
+{
+	for (auto& phase : m_phases)
+		phase = PerfCounters::Sample();
+	m_phase = EVALUATE;
+	m_mark = m_counters.Read();
+}
+
+/// <summary>
+/// Evaluation is done, toggles are applied next
+/// </summary>
+/// <param name="board"></param>
+/// <param name="toggled"></param>
+void PhaseProfiler::OnApplyStarted(Board& board, BoardState& toggled)
+{
+	EndPhase();
+	m_phase = APPLY;
+}
+
+/// <summary>
+/// Toggles are applied. Anything the engine does after counts as evaluation again
+/// </summary>
+/// <param name="board"></param>
+void PhaseProfiler::OnApplyEnded(Board& board)
+{
+	EndPhase();
+	m_phase = EVALUATE;
+}
+
+/// <summary>
+/// Finish counting an update and print it
+/// </summary>
+void PhaseProfiler::EndGeneration()
+{
+	EndPhase();
+	++m_generation;
+	for (size_t p = 0; p < PHASE_COUNT; ++p)
+	{
+		PrintLine(std::to_string(m_generation), (Phase)p, m_phases[p]);
+		m_totals[p] += m_phases[p];
+	}
+}
+
+/// <summary>
+/// Print the sums over all generations
+/// </summary>
+void PhaseProfiler::PrintTotals()
+{
+	for (size_t p = 0; p < PHASE_COUNT; ++p)
+		PrintLine("total", (Phase)p, m_totals[p]);
+}
+
+/// <summary>
+/// One line: label, phase, seconds, then each counter or - if not available
+/// </summary>
+/// <param name="label"></param>
+/// <param name="phase"></param>
+/// <param name="sample"></param>
+void PhaseProfiler::PrintLine(const std::string& label, Phase phase, const PerfCounters::Sample& sample)
+{
+	m_out << "#P " << label << ' ' << (phase == EVALUATE ? "evaluate" : "apply")
+		<< ' ' << std::fixed << std::setprecision(6) << sample.m_seconds;
+	for (size_t e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+	{
+		if (sample.m_valid[e])
+			m_out << ' ' << sample.m_values[e];
+		else
+			m_out << " -";
+	}
+	m_out << '\n';
+}
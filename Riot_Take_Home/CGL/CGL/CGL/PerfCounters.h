@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "Board.h"
+
+/// <summary>
+/// Hardware performance counters of the calling thread, read through Linux
+/// perf_event_open. Counters that the kernel or CPU do not provide are marked
+/// invalid; on other platforms none are available.
+/// </summary>
+class PerfCounters
+{
+	public:
+
+		enum Event
+		{
+			CYCLES,
+			INSTRUCTIONS,
+			L1D_MISSES,
+			LLC_MISSES,
+			BRANCH_MISSES,
+			EVENT_COUNT
+		};
+
+		static const char* const EVENT_NAMES[EVENT_COUNT];
+
+		/// <summary>
+		/// Counter values, cumulative or as the difference of two reads
+		/// </summary>
+		struct Sample
+		{
+			uint64_t m_values[EVENT_COUNT] = {};
+			bool m_valid[EVENT_COUNT] = {};
+			double m_seconds = 0;
+
+			Sample& operator+=(const Sample& other);
+			Sample operator-(const Sample& other) const;
+		};
+
+	private:
+
+		int m_leader = -1;
+		int m_fds[EVENT_COUNT];
+		size_t m_slots[EVENT_COUNT];	// Position of each event in a group read
+		size_t m_opened = 0;
+		std::string m_error;
+
+		PerfCounters(const PerfCounters&) = delete;
+		PerfCounters& operator=(const PerfCounters&) = delete;
+
+	public:
+
+		// Opens and starts the counters
+		PerfCounters();
+		~PerfCounters();
+
+		inline bool IsAvailable() const
+		{
+			return m_leader >= 0;
+		}
+
+		// Why some or all counters are not available
+		inline const std::string& Error() const
+		{
+			return m_error;
+		}
+
+		// Cumulative values since construction, scaled if the kernel multiplexed the counters
+		Sample Read() const;
+};
+
+/// <summary>
+/// Per generation counters split in to the neighbour evaluation pass of an
+/// update engine and the pass applying its toggles. Register it as the last
+/// toggle observer of the board and bracket every update with
+/// BeginGeneration and EndGeneration.
+/// </summary>
+class PhaseProfiler : public Board::ToggleObserver
+{
+	public:
+
+		enum Phase
+		{
+			EVALUATE,
+			APPLY,
+			PHASE_COUNT
+		};
+
+	private:
+
+		PerfCounters m_counters;
+		std::ostream& m_out;
+		PerfCounters::Sample m_mark;
+		PerfCounters::Sample m_phases[PHASE_COUNT];
+		PerfCounters::Sample m_totals[PHASE_COUNT];
+		Phase m_phase = EVALUATE;
+		size_t m_generation = 0;
+
+		void EndPhase();
+		void PrintLine(const std::string& label, Phase phase, const PerfCounters::Sample& sample);
+
+	public:
+
+		PhaseProfiler(std::ostream& out);
+
+		void BeginGeneration();
+		void OnApplyStarted(Board& board, BoardState& toggled) override;
+		void OnApplyEnded(Board& board) override;
+		// Print the generation's phases
+		void EndGeneration();
+		// Print the sums over all generations
+		void PrintTotals();
+};
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "CellCodec.h"
+#include "MappedFile.h"
+#include "ResultCache.h"
+
+const char ResultCache::MAGIC[4] = { 'C', 'G', 'L', 'C' };
+
+namespace
+{
+	const uint64_t MAX = (uint64_t)std::numeric_limits<int64_t>::max();
+	const uint64_t MIN = (uint64_t)std::numeric_limits<int64_t>::min();
+
+	void Fnv(uint64_t& hash, const void* data, size_t length)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < length; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+}
+
+/// <summary>
+/// ctor, creates the directory if needed
+/// </summary>
+/// <param name="directory"></param>
+/// <param name="maxBytes">:size limit of all entries, 0 for none</param>
+/// <param name="rule">:rule the results were computed with, part of the key</param>
+ResultCache::ResultCache(const std::string& directory, uint64_t maxBytes, const std::string& rule)
+	: m_directory(directory), m_maxBytes(maxBytes), m_rule(rule)
+{
+	std::error_code error;
+	std::filesystem::create_directories(m_directory, error);
+	if (!std::filesystem::is_directory(m_directory))
+		throw std::runtime_error("cannot create cache directory \"" + m_directory + "\"");
+}
+
+/// <summary>
+/// Move the board to 0, 0 unless it may reach a wall, then hash rule, generations and cells
+/// </summary>
+/// <param name="initial"></param>
+/// <param name="generations"></param>
+/// <returns></returns>
+ResultCache::Key ResultCache::MakeKey(const Pattern& initial, uint64_t generations) const
+{
+	Key key;
+	bool absolute = true;
+	if (!initial.empty())
+	{
+		int64_t top = initial[0].m_row, bottom = top;
+		int64_t left = initial[0].m_col, right = left;
+		for (const auto& cell : initial)
+		{
+			top = std::min(top, cell.m_row);
+			bottom = std::max(bottom, cell.m_row);
+			left = std::min(left, cell.m_col);
+			right = std::max(right, cell.m_col);
+		}
+		const uint64_t reach = generations + 1;
+		absolute = reach == 0 || (uint64_t)top - MIN <= reach || MAX - (uint64_t)bottom <= reach
+			|| (uint64_t)left - MIN <= reach || MAX - (uint64_t)right <= reach;
+		if (!absolute)
+		{
+			key.m_originRow = (uint64_t)top;
+			key.m_originCol = (uint64_t)left;
+		}
+	}
+
+	std::vector<BoardState::Cell> cells;
+	cells.reserve(initial.size());
+	for (const auto& cell : initial)
+		cells.emplace_back((int64_t)((uint64_t)cell.m_row - key.m_originRow), (int64_t)((uint64_t)cell.m_col - key.m_originCol));
+	CellCodec::Sort(cells);
+	CellCodec::Encode(cells, key.m_initial);
+
+	key.m_hash = 14695981039346656037ULL;
+	Fnv(key.m_hash, m_rule.data(), m_rule.size());
+	Fnv(key.m_hash, &generations, sizeof(generations));
+	Fnv(key.m_hash, &absolute, sizeof(absolute));
+	Fnv(key.m_hash, key.m_initial.data(), key.m_initial.size());
+	return key;
+}
+
+/// <summary>
+/// File of an entry
+/// </summary>
+/// <param name="key"></param>
+/// <returns></returns>
+std::string ResultCache::PathOf(const Key& key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.cgl", (unsigned long long)key.m_hash);
+	return (std::filesystem::path(m_directory) / name).string();
+}
+
+/// <summary>
+/// Look up a result. The entry is mapped, checked against the initial board and decoded
+/// </summary>
+/// <param name="initial"></param>
+/// <param name="generations"></param>
+/// <param name="result"></param>
+/// <returns>true on a hit</returns>
+bool ResultCache::Find(const Pattern& initial, uint64_t generations, Pattern& result)
+{
+	Key key = MakeKey(initial, generations);
+	std::string path = PathOf(key);
+	std::error_code error;
+	if (!std::filesystem::is_regular_file(path, error))
+		return false;
+
+	MappedFile file;
+	try
+	{
+		file.OpenReadOnly(path);
+	}
+	catch (const std::exception&)
+	{
+		return false;	// Removed by another process in between
+	}
+	if (file.Size() == 0)
+		return false;
+
+	size_t size = (size_t)file.Size();
+	const uint8_t* view = static_cast<const uint8_t*>(file.Map(0, size, false));
+	const uint8_t* in = view;
+	const uint8_t* end = view + size;
+	bool hit = false;
+	try
+	{
+		uint64_t ruleLength = 0, storedGenerations = 0, initialLength = 0;
+		if (size > sizeof(MAGIC) && std::equal(MAGIC, MAGIC + sizeof(MAGIC), reinterpret_cast<const char*>(in))
+			&& in[sizeof(MAGIC)] == VERSION)
+		{
+			in += sizeof(MAGIC) + 1;
+			hit = CellCodec::GetVarint(in, end, ruleLength) && ruleLength <= (uint64_t)(end - in)
+				&& std::string(reinterpret_cast<const char*>(in), (size_t)ruleLength) == m_rule;
+			in += hit ? ruleLength : 0;
+			hit = hit && CellCodec::GetVarint(in, end, storedGenerations) && storedGenerations == generations
+				&& CellCodec::GetVarint(in, end, initialLength) && initialLength == key.m_initial.size()
+				&& initialLength <= (uint64_t)(end - in) && std::equal(in, in + initialLength, reinterpret_cast<const uint8_t*>(key.m_initial.data()));
+		}
+		if (hit)
+		{
+			in += initialLength;
+			result.clear();
+			CellCodec::Decode(in, end, result);
+			for (auto& cell : result)
+				cell = BoardState::Cell((int64_t)((uint64_t)cell.m_row + key.m_originRow), (int64_t)((uint64_t)cell.m_col + key.m_originCol));
+		}
+	}
+	catch (const std::exception&)
+	{
+		hit = false;	// Damaged entry, it is replaced on the next store
+	}
+	MappedFile::Unmap(const_cast<uint8_t*>(view), size);
+	file.Close();
+
+	if (hit)
+		std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+	return hit;
+}
+
+/// <summary>
+/// Add a result. The entry is written to a temporary file and renamed in to
+/// place, so concurrent runs never see a partial entry
+/// </summary>
+/// <param name="initial"></param>
+/// <param name="generations"></param>
+/// <param name="result"></param>
+void ResultCache::Store(const Pattern& initial, uint64_t generations, const Pattern& result)
+{
+	Key key = MakeKey(initial, generations);
+
+	std::string data(MAGIC, sizeof(MAGIC));
+	data.push_back((char)VERSION);
+	CellCodec::PutVarint(data, m_rule.size());
+	data += m_rule;
+	CellCodec::PutVarint(data, generations);
+	CellCodec::PutVarint(data, key.m_initial.size());
+	data += key.m_initial;
+
+	std::vector<BoardState::Cell> cells;
+	cells.reserve(result.size());
+	for (const auto& cell : result)
+		cells.emplace_back((int64_t)((uint64_t)cell.m_row - key.m_originRow), (int64_t)((uint64_t)cell.m_col - key.m_originCol));
+	CellCodec::Sort(cells);
+	CellCodec::Encode(cells, data);
+
+	std::string path = PathOf(key);
+	std::string temp = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))
+		+ std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+	{
+		std::ofstream out(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!out.write(data.data(), data.size()))
+			throw std::runtime_error("cannot write cache entry \"" + temp + "\"");
+	}
+	std::error_code error;
+	std::filesystem::rename(temp, path, error);
+	if (error)
+	{
+		std::filesystem::remove(temp, error);
+		return;
+	}
+	Evict(path);
+}
+
+/// <summary>
+/// Remove the least recently used entries while the cache is over its limit
+/// </summary>
+/// <param name="keep">:entry just stored, never removed</param>
+void ResultCache::Evict(const std::string& keep)
+{
+	if (m_maxBytes == 0)
+		return;
+
+	struct Entry
+	{
+		std::filesystem::file_time_type m_used;
+		uint64_t m_size;
+		std::filesystem::path m_path;
+	};
+
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+	std::error_code error;
+	for (const auto& file : std::filesystem::directory_iterator(m_directory, error))
+	{
+		if (file.path().extension() != ".cgl" || !file.is_regular_file(error))
+			continue;
+		Entry entry = { file.last_write_time(error), file.file_size(error), file.path() };
+		if (error)
+			continue;
+		total += entry.m_size;
+		entries.push_back(entry);
+	}
+	if (total <= m_maxBytes)
+		return;
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.m_used < b.m_used; });
+	for (const auto& entry : entries)
+	{
+		if (total <= m_maxBytes)
+			break;
+		if (entry.m_path == std::filesystem::path(keep))
+			continue;
+		if (std::filesystem::remove(entry.m_path, error))
+			total -= entry.m_size;
+	}
+}
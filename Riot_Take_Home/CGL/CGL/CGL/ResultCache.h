@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "LifeIO.h"
+
+/// <summary>
+/// On disk cache of simulation results across runs, keyed by the initial
+/// board, the rule and the generation count.
+/// Boards are moved so their bounding box starts at 0, 0 before hashing, so
+/// a pattern hits wherever it is placed; boards that could reach the INT64
+/// walls within the run keep their position in the key. Every entry is one
+/// file named after the key hash:
+///   "CGLC", version byte, varint rule length and rule, varint generations,
+///   varint length and initial cells, result cells (CellCodec lists)
+/// The stored initial cells are compared on a hit, so hash collisions miss.
+/// Entries are touched on every hit and the least recently used are removed
+/// once the directory grows past its size limit.
+/// </summary>
+class ResultCache
+{
+	public:
+
+		static const char MAGIC[4];
+		static const uint8_t VERSION = 1;
+
+	private:
+
+		/// <summary>
+		/// Position independent form of an initial board
+		/// </summary>
+		struct Key
+		{
+			uint64_t m_hash = 0;
+			uint64_t m_originRow = 0;	// Subtracted from every cell
+			uint64_t m_originCol = 0;
+			std::string m_initial;		// Encoded, moved and sorted cells
+		};
+
+		std::string m_directory;
+		uint64_t m_maxBytes;
+		std::string m_rule;
+
+		Key MakeKey(const Pattern& initial, uint64_t generations) const;
+		std::string PathOf(const Key& key) const;
+		void Evict(const std::string& keep);
+
+	public:
+
+		// maxBytes: size limit of all entries, 0 for none
+		ResultCache(const std::string& directory, uint64_t maxBytes, const std::string& rule = "B3/S23");
+
+		// On a hit fill result with the cells after generations, in board coordinates
+		bool Find(const Pattern& initial, uint64_t generations, Pattern& result);
+		void Store(const Pattern& initial, uint64_t generations, const Pattern& result);
+};
@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "ShardTransport.h"
+
+#if !defined(_WIN32)
+
+namespace
+{
+	// Workers started before their coordinator keep trying this long
+	const std::chrono::seconds CONNECT_TIMEOUT(30);
+
+	// First bytes a worker sends: magic and protocol version. Bump the version with any message format change
+	const char HELLO[8] = { 'C', 'G', 'L', 'S', 1, 0, 0, 0 };
+
+	// Time a new client has to send its hello before it is dropped
+	const int HELLO_TIMEOUT_SECONDS = 5;
+
+	/// <summary>
+	/// Send the worker hello on a freshly connected socket
+	/// </summary>
+	/// <param name="socket"></param>
+	/// <returns>false if the send failed</returns>
+	bool SendHello(int socket)
+	{
+#if defined(MSG_NOSIGNAL)
+		const int flags = MSG_NOSIGNAL;
+#else
+		const int flags = 0;
+#endif
+		size_t sent = 0;
+		while (sent < sizeof(HELLO))
+		{
+			ssize_t n = send(socket, HELLO + sent, sizeof(HELLO) - sent, flags);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			sent += static_cast<size_t>(n);
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Wait a bounded time for the worker hello on an accepted socket
+	/// </summary>
+	/// <param name="socket"></param>
+	/// <returns>true if the client sent the hello of this version</returns>
+	bool ReceiveHello(int socket)
+	{
+		timeval timeout = { HELLO_TIMEOUT_SECONDS, 0 };
+		setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		char hello[sizeof(HELLO)];
+		size_t received = 0;
+		while (received < sizeof(hello))
+		{
+			ssize_t n = recv(socket, hello + received, sizeof(hello) - received, 0);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			received += static_cast<size_t>(n);
+		}
+		timeout = { 0, 0 };
+		setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		return std::memcmp(hello, HELLO, sizeof(HELLO)) == 0;
+	}
+
+	/// <summary>
+	/// Accept clients until one sends the worker hello, closing the others
+	/// </summary>
+	/// <param name="listener"></param>
+	/// <returns>the worker socket</returns>
+	int AcceptWorker(int listener)
+	{
+		while (true)
+		{
+			int client = accept(listener, nullptr, nullptr);
+			if (client >= 0)
+			{
+				if (ReceiveHello(client))
+					return client;
+				close(client);
+				continue;
+			}
+			if (errno != EINTR && errno != ECONNABORTED)
+				throw std::runtime_error(std::string("accept failed: ") + std::strerror(errno));
+		}
+	}
+
+	/// <summary>
+	/// Unix domain socket transport
+	/// </summary>
+	class UnixTransport : public ShardTransport
+	{
+		private:
+
+			std::string m_path;
+			int m_listener = -1;
+			bool m_owner = false;	// Created the socket file, removed once the transport is destroyed
+
+			sockaddr_un Address() const
+			{
+				sockaddr_un addr;
+				std::memset(&addr, 0, sizeof(addr));
+				addr.sun_family = AF_UNIX;
+				if (m_path.empty() || m_path.size() >= sizeof(addr.sun_path))
+					throw std::invalid_argument("invalid socket path \"" + m_path + "\"");
+				std::memcpy(addr.sun_path, m_path.c_str(), m_path.size());
+				return addr;
+			}
+
+		public:
+
+			explicit UnixTransport(const std::string& path) : m_path(path) {}
+
+			~UnixTransport()
+			{
+				Close();
+				if (m_owner)
+					unlink(m_path.c_str());
+			}
+
+			void Listen() override
+			{
+				sockaddr_un addr = Address();
+				m_listener = socket(AF_UNIX, SOCK_STREAM, 0);
+				if (m_listener < 0)
+					throw std::runtime_error("cannot create socket");
+				unlink(m_path.c_str());	// Stale socket of an earlier run
+				if (bind(m_listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_listener, SOMAXCONN) != 0)
+					throw std::runtime_error("cannot listen on \"" + m_path + "\": " + std::strerror(errno));
+				m_owner = true;
+			}
+
+			std::unique_ptr<ShardChannel> Accept() override
+			{
+				return std::unique_ptr<ShardChannel>(new ShardChannel(AcceptWorker(m_listener)));
+			}
+
+			std::unique_ptr<ShardChannel> Connect() override
+			{
+				sockaddr_un addr = Address();
+				auto deadline = std::chrono::steady_clock::now() + CONNECT_TIMEOUT;
+				while (true)
+				{
+					int server = socket(AF_UNIX, SOCK_STREAM, 0);
+					if (server < 0)
+						throw std::runtime_error("cannot create socket");
+					if (connect(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 && SendHello(server))
+						return std::unique_ptr<ShardChannel>(new ShardChannel(server));
+					int error = errno;
+					close(server);
+					if (std::chrono::steady_clock::now() > deadline)
+						throw std::runtime_error("cannot connect to \"" + m_path + "\": " + std::strerror(error));
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				}
+			}
+
+			void Close() override
+			{
+				if (m_listener >= 0)
+					close(m_listener);
+				m_listener = -1;
+			}
+	};
+
+	/// <summary>
+	/// TCP transport, Nagle is off as every generation waits on small halo messages
+	/// </summary>
+	class TcpTransport : public ShardTransport
+	{
+		private:
+
+			std::string m_host;
+			std::string m_port;
+			int m_listener = -1;
+
+			addrinfo* Resolve(bool passive) const
+			{
+				addrinfo hints;
+				std::memset(&hints, 0, sizeof(hints));
+				hints.ai_family = AF_UNSPEC;
+				hints.ai_socktype = SOCK_STREAM;
+				hints.ai_flags = passive ? AI_PASSIVE : 0;
+				addrinfo* result = nullptr;
+				int error = getaddrinfo(m_host.empty() ? nullptr : m_host.c_str(), m_port.c_str(), &hints, &result);
+				if (error != 0)
+					throw std::runtime_error("cannot resolve \"" + m_host + ":" + m_port + "\": " + gai_strerror(error));
+				return result;
+			}
+
+			static void NoDelay(int socket)
+			{
+				int on = 1;
+				setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+			}
+
+		public:
+
+			TcpTransport(const std::string& host, const std::string& port) : m_host(host), m_port(port) {}
+
+			~TcpTransport()
+			{
+				Close();
+			}
+
+			void Listen() override
+			{
+				addrinfo* addresses = Resolve(true);
+				for (addrinfo* address = addresses; address != nullptr && m_listener < 0; address = address->ai_next)
+				{
+					m_listener = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+					if (m_listener < 0)
+						continue;
+					int on = 1;
+					setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+					if (bind(m_listener, address->ai_addr, address->ai_addrlen) != 0 || listen(m_listener, SOMAXCONN) != 0)
+					{
+						close(m_listener);
+						m_listener = -1;
+					}
+				}
+				freeaddrinfo(addresses);
+				if (m_listener < 0)
+					throw std::runtime_error("cannot listen on \"" + m_host + ":" + m_port + "\": " + std::strerror(errno));
+			}
+
+			std::unique_ptr<ShardChannel> Accept() override
+			{
+				int client = AcceptWorker(m_listener);
+				NoDelay(client);
+				return std::unique_ptr<ShardChannel>(new ShardChannel(client));
+			}
+
+			std::unique_ptr<ShardChannel> Connect() override
+			{
+				auto deadline = std::chrono::steady_clock::now() + CONNECT_TIMEOUT;
+				while (true)
+				{
+					addrinfo* addresses = Resolve(false);
+					int error = 0;
+					for (addrinfo* address = addresses; address != nullptr; address = address->ai_next)
+					{
+						int server = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+						if (server < 0)
+							continue;
+						if (connect(server, address->ai_addr, address->ai_addrlen) == 0 && SendHello(server))
+						{
+							freeaddrinfo(addresses);
+							NoDelay(server);
+							return std::unique_ptr<ShardChannel>(new ShardChannel(server));
+						}
+						error = errno;
+						close(server);
+					}
+					freeaddrinfo(addresses);
+					if (std::chrono::steady_clock::now() > deadline)
+						throw std::runtime_error("cannot connect to \"" + m_host + ":" + m_port + "\": " + std::strerror(error));
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				}
+			}
+
+			void Close() override
+			{
+				if (m_listener >= 0)
+					close(m_listener);
+				m_listener = -1;
+			}
+	};
+}
+
+/// <summary>
+/// dtor
+/// </summary>
+ShardChannel::~ShardChannel()
+{
+	if (m_socket >= 0)
+		close(m_socket);
+}
+
+/// <summary>
+/// Write a message: 8 byte little endian length, then the bytes
+/// </summary>
+/// <param name="message"></param>
+void ShardChannel::Send(const std::string& message)
+{
+#if defined(MSG_NOSIGNAL)
+	const int flags = MSG_NOSIGNAL;	// A peer that went away is reported, not a signal
+#else
+	const int flags = 0;
+#endif
+	uint64_t length = message.size();
+	if (length > MAX_MESSAGE_BYTES)
+		throw std::runtime_error("shard message of " + std::to_string(length) + " bytes is over the limit");
+	std::string data(8, '\0');
+	for (int i = 0; i < 8; ++i)
+		data[i] = (char)(length >> (8 * i));
+	data += message;
+
+	size_t sent = 0;
+	while (sent < data.size())
+	{
+		ssize_t n = send(m_socket, data.data() + sent, data.size() - sent, flags);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			throw std::runtime_error(std::string("shard connection lost: ") + std::strerror(errno));
+		sent += static_cast<size_t>(n);
+	}
+}
+
+/// <summary>
+/// Read one message
+/// </summary>
+/// <param name="message"></param>
+/// <returns>false once the peer closed the connection</returns>
+bool ShardChannel::Receive(std::string& message)
+{
+	auto read = [this](char* data, size_t length)
+	{
+		size_t received = 0;
+		while (received < length)
+		{
+			ssize_t n = recv(m_socket, data + received, length - received, 0);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			received += static_cast<size_t>(n);
+		}
+		return true;
+	};
+
+	unsigned char header[8];
+	if (!read(reinterpret_cast<char*>(header), sizeof(header)))
+		return false;
+	uint64_t length = 0;
+	for (int i = 0; i < 8; ++i)
+		length |= (uint64_t)header[i] << (8 * i);
+	if (length > MAX_MESSAGE_BYTES)
+		throw std::runtime_error("shard message of " + std::to_string(length) + " bytes is over the limit");
+
+	// Grow with the bytes that actually arrive rather than trusting the length up front
+	const size_t CHUNK = 1 << 20;
+	message.clear();
+	while (message.size() < length)
+	{
+		size_t received = message.size();
+		message.resize(received + std::min<size_t>(CHUNK, (size_t)length - received));
+		if (!read(&message[received], message.size() - received))
+			return false;
+	}
+	return true;
+}
+
+#else
+
+ShardChannel::~ShardChannel()
+{
+}
+
+void ShardChannel::Send(const std::string& message)
+{
+	throw std::runtime_error("sharding is not supported on this platform");
+}
+
+bool ShardChannel::Receive(std::string& message)
+{
+	throw std::runtime_error("sharding is not supported on this platform");
+}
+
+#endif
+
+/// <summary>
+/// Create the transport for an address
+/// </summary>
+/// <param name="address">:unix:PATH or tcp:HOST:PORT</param>
+/// <returns></returns>
+std::unique_ptr<ShardTransport> ShardTransport::Create(const std::string& address)
+{
+#if !defined(_WIN32)
+	if (address.compare(0, 5, "unix:") == 0)
+		return std::unique_ptr<ShardTransport>(new UnixTransport(address.substr(5)));
+	if (address.compare(0, 4, "tcp:") == 0)
+	{
+		size_t colon = address.rfind(':');
+		if (colon < 4 || colon + 1 == address.size())
+			throw std::invalid_argument("expecting tcp:HOST:PORT, not \"" + address + "\"");
+		std::string host = address.substr(4, colon - 4);
+		if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+			host = host.substr(1, host.size() - 2);	// [IPv6]
+		return std::unique_ptr<ShardTransport>(new TcpTransport(host, address.substr(colon + 1)));
+	}
+	throw std::invalid_argument("unknown shard transport \"" + address + "\"");
+#else
+	throw std::runtime_error("sharding is not supported on this platform");
+#endif
+}
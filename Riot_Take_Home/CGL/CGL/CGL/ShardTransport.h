@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/// <summary>
+/// Connected stream carrying length prefixed messages between the shard
+/// coordinator and one shard worker
+/// </summary>
+class ShardChannel
+{
+	private:
+
+		int m_socket = -1;
+
+	public:
+
+		// Larger messages are refused on both ends, a stripe of 64M live cells still fits
+		static const uint64_t MAX_MESSAGE_BYTES = 1ull << 30;
+
+		explicit ShardChannel(int socket) : m_socket(socket) {}
+		ShardChannel(const ShardChannel&) = delete;
+		ShardChannel& operator=(const ShardChannel&) = delete;
+		virtual ~ShardChannel();
+
+		void Send(const std::string& message);
+		// Returns false once the peer closed the connection, throws for a message over MAX_MESSAGE_BYTES
+		bool Receive(std::string& message);
+};
+
+/// <summary>
+/// How shard workers reach the coordinator. Addresses are
+///   unix:PATH          Unix domain socket, workers on this host
+///   tcp:HOST:PORT      TCP, workers on any host; the coordinator binds HOST
+/// </summary>
+class ShardTransport
+{
+	public:
+
+		// Throws std::invalid_argument for an unknown address
+		static std::unique_ptr<ShardTransport> Create(const std::string& address);
+
+		virtual ~ShardTransport() {}
+
+		// Coordinator side: start listening, then accept one worker per call.
+		// Clients that do not open with the worker hello in time are dropped
+		virtual void Listen() = 0;
+		virtual std::unique_ptr<ShardChannel> Accept() = 0;
+		// Worker side: connect to a listening coordinator, retrying for a while, and send the hello
+		virtual std::unique_ptr<ShardChannel> Connect() = 0;
+		// Release the listening endpoint. Forked workers close their inherited copy
+		virtual void Close() = 0;
+};
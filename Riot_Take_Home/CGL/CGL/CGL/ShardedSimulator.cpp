@@ -0,0 +1,608 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "CellCodec.h"
+#include "ShardedSimulator.h"
+
+namespace
+{
+	const int64_t MAX = std::numeric_limits<int64_t>::max();
+	const int64_t MIN = std::numeric_limits<int64_t>::min();
+
+	// Stripes are only rebalanced once the fullest holds this much more than the average
+	const double IMBALANCE = 1.25;
+
+	void PutInt(std::string& out, int64_t value)
+	{
+		CellCodec::PutVarint(out, CellCodec::ZigZag(value));
+	}
+
+	/// <summary>
+	/// Sequential reader of one message
+	/// </summary>
+	class MessageReader
+	{
+		private:
+
+			const uint8_t* m_in;
+			const uint8_t* m_end;
+
+		public:
+
+			explicit MessageReader(const std::string& message)
+				: m_in(reinterpret_cast<const uint8_t*>(message.data())), m_end(m_in + message.size()) {}
+
+			char GetChar()
+			{
+				if (m_in == m_end)
+					throw std::runtime_error("truncated shard message");
+				return (char)*m_in++;
+			}
+
+			uint64_t GetUInt()
+			{
+				uint64_t value = 0;
+				if (!CellCodec::GetVarint(m_in, m_end, value))
+					throw std::runtime_error("truncated shard message");
+				return value;
+			}
+
+			int64_t GetInt()
+			{
+				return CellCodec::UnZigZag(GetUInt());
+			}
+
+			std::string GetString()
+			{
+				uint64_t length = GetUInt();
+				if (length > (uint64_t)(m_end - m_in))
+					throw std::runtime_error("truncated shard message");
+				std::string value(reinterpret_cast<const char*>(m_in), (size_t)length);
+				m_in += length;
+				return value;
+			}
+
+			void GetCells(Pattern& cells)
+			{
+				cells.clear();
+				CellCodec::Decode(m_in, m_end, cells);
+			}
+	};
+
+	/// <summary>
+	/// One stripe of the board and its engine, owned by a worker process
+	/// </summary>
+	class ShardWorker
+	{
+		private:
+
+			ShardedSimulator::EngineFactory m_factory;
+			Board m_board;
+			std::unique_ptr<Board::Visitor> m_engine;
+			int64_t m_top = MIN;
+			int64_t m_bottom = MAX;
+
+			/// <summary>
+			/// Drop cells outside the stripe and append the stripe state to reply
+			/// </summary>
+			/// <param name="reply"></param>
+			void Trim(std::string& reply)
+			{
+				Pattern outside, topRow, bottomRow;
+				m_board.ForEach([&](int64_t row, int64_t col)
+				{
+					if (row < m_top || row > m_bottom)
+						outside.emplace_back(row, col);
+					else
+					{
+						if (row == m_top)
+							topRow.emplace_back(row, col);
+						if (row == m_bottom)
+							bottomRow.emplace_back(row, col);
+					}
+					return true;
+				});
+				for (const auto& cell : outside)
+					m_board.QueueToggle(cell.m_row, cell.m_col);
+				m_board.ApplyToggles();
+
+				reply.push_back('R');
+				PutInt(reply, m_top);
+				PutInt(reply, m_bottom);
+				CellCodec::PutVarint(reply, m_board.Size());
+				CellCodec::Encode(topRow, reply);
+				CellCodec::Encode(bottomRow, reply);
+			}
+
+			/// <summary>
+			/// Remove whole edge rows holding at least count cells, the stripe keeps its far edge row
+			/// </summary>
+			/// <param name="fromTop"></param>
+			/// <param name="count"></param>
+			/// <param name="reply"></param>
+			void Give(bool fromTop, uint64_t count, std::string& reply)
+			{
+				Pattern cells;
+				cells.reserve(m_board.Size());
+				m_board.ForEach([&cells](int64_t row, int64_t col) { cells.emplace_back(row, col); return true; });
+				CellCodec::Sort(cells);
+				if (!fromTop)
+					std::reverse(cells.begin(), cells.end());
+
+				Pattern given;
+				size_t i = 0;
+				while (i < cells.size() && given.size() < count)
+				{
+					int64_t row = cells[i].m_row;
+					if (row == (fromTop ? m_bottom : m_top))
+						break;
+					for (; i < cells.size() && cells[i].m_row == row; ++i)
+					{
+						given.push_back(cells[i]);
+						m_board.QueueToggle(cells[i].m_row, cells[i].m_col);
+					}
+					if (fromTop)
+						m_top = row + 1;
+					else
+						m_bottom = row - 1;
+				}
+				m_board.ApplyToggles();
+
+				CellCodec::Encode(given, reply);
+				Trim(reply);
+			}
+
+		public:
+
+			explicit ShardWorker(ShardedSimulator::EngineFactory factory) : m_factory(factory) {}
+
+			/// <summary>
+			/// Execute one message
+			/// </summary>
+			/// <param name="message"></param>
+			/// <param name="reply"></param>
+			/// <returns>false on quit</returns>
+			bool Execute(const std::string& message, std::string& reply)
+			{
+				MessageReader reader(message);
+				Pattern cells;
+				char command = reader.GetChar();
+				switch (command)
+				{
+					case 'L':
+					{
+						std::string engine = reader.GetString();
+						m_engine = m_factory(engine);
+						if (!m_engine)
+							throw std::invalid_argument("unknown engine \"" + engine + "\"");
+						m_top = reader.GetInt();
+						m_bottom = reader.GetInt();
+						reader.GetCells(cells);
+						m_board.Clear();
+						for (const auto& cell : cells)
+							m_board.Initialize(cell.m_row, cell.m_col);
+						Trim(reply);
+						return true;
+					}
+					case 'S':
+					{
+						if (!m_engine)
+							throw std::logic_error("stripe not loaded");
+						for (int side = 0; side < 2; ++side)
+						{
+							reader.GetCells(cells);
+							for (const auto& cell : cells)
+								m_board.Initialize(cell.m_row, cell.m_col);
+						}
+						m_board.Accept(m_engine.get());
+						Trim(reply);
+						return true;
+					}
+					case 'G':
+					{
+						bool fromTop = reader.GetChar() == 'T';
+						Give(fromTop, reader.GetUInt(), reply);
+						return true;
+					}
+					case 'T':
+					{
+						m_top = reader.GetInt();
+						m_bottom = reader.GetInt();
+						reader.GetCells(cells);
+						for (const auto& cell : cells)
+							m_board.Initialize(cell.m_row, cell.m_col);
+						Trim(reply);
+						return true;
+					}
+					case 'D':
+					{
+						cells.reserve(m_board.Size());
+						m_board.ForEach([&cells](int64_t row, int64_t col) { cells.emplace_back(row, col); return true; });
+						CellCodec::Sort(cells);
+						reply.push_back('C');
+						CellCodec::Encode(cells, reply);
+						return true;
+					}
+					case 'Q':
+						return false;
+					default:
+						throw std::invalid_argument(std::string("unknown shard command '") + command + "'");
+				}
+			}
+	};
+
+	/// <summary>
+	/// Read the reply of a worker, failures of the worker are rethrown here
+	/// </summary>
+	/// <param name="channel"></param>
+	/// <param name="reply"></param>
+	void ReceiveReply(ShardChannel& channel, std::string& reply)
+	{
+		if (!channel.Receive(reply) || reply.empty())
+			throw std::runtime_error("shard worker disconnected");
+		if (reply[0] == 'E')
+			throw std::runtime_error("shard worker: " + reply.substr(1));
+	}
+
+	/// <summary>
+	/// Read a stripe state reply in to a shard
+	/// </summary>
+	/// <param name="reader"></param>
+	/// <param name="top"></param>
+	/// <param name="bottom"></param>
+	/// <param name="population"></param>
+	/// <param name="topRow"></param>
+	/// <param name="bottomRow"></param>
+	void ReadState(MessageReader& reader, int64_t& top, int64_t& bottom, uint64_t& population, Pattern& topRow, Pattern& bottomRow)
+	{
+		if (reader.GetChar() != 'R')
+			throw std::runtime_error("unexpected shard reply");
+		top = reader.GetInt();
+		bottom = reader.GetInt();
+		population = reader.GetUInt();
+		reader.GetCells(topRow);
+		reader.GetCells(bottomRow);
+	}
+}
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="factory">:creates the update engine of each worker by name</param>
+/// <param name="engine">:engine name</param>
+/// <param name="shards">:stripes, one worker each</param>
+/// <param name="address">:transport of the workers, empty for a Unix socket in the temp directory</param>
+/// <param name="spawn">:workers forked here, at most shards</param>
+/// <param name="rebalance">:generations between rebalancing checks, 0 for fixed stripes</param>
+ShardedSimulator::ShardedSimulator(EngineFactory factory, const std::string& engine, size_t shards, const std::string& address, size_t spawn, size_t rebalance)
+	: m_address(address), m_numShards(shards), m_spawn(std::min(spawn, shards)), m_engine(engine), m_rebalance(rebalance), m_factory(factory)
+{
+	if (!m_factory)
+		throw std::invalid_argument("engine factory cannot be null");
+	if (m_numShards == 0 || m_numShards > 65536)
+		throw std::invalid_argument("shards must be between 1 and 65536");
+	if (m_address.empty())
+	{
+#if !defined(_WIN32)
+		std::string name = "cgl-shards-" + std::to_string(getpid()) + ".sock";
+#else
+		std::string name = "cgl-shards.sock";
+#endif
+		m_address = "unix:" + (std::filesystem::temp_directory_path() / name).string();
+	}
+}
+
+/// <summary>
+/// dtor, closing the channels ends the workers of an interrupted run
+/// </summary>
+ShardedSimulator::~ShardedSimulator()
+{
+	m_shards.clear();
+	Stop();
+}
+
+/// <summary>
+/// Reap the forked workers
+/// </summary>
+void ShardedSimulator::Stop()
+{
+#if !defined(_WIN32)
+	for (int child : m_children)
+		waitpid(child, nullptr, 0);
+#endif
+	m_children.clear();
+}
+
+/// <summary>
+/// Listen, fork the local workers and accept all of them
+/// </summary>
+/// <param name="transport"></param>
+void ShardedSimulator::Start(ShardTransport& transport)
+{
+	transport.Listen();
+#if !defined(_WIN32)
+	std::cout.flush();
+	std::cerr.flush();
+	for (size_t i = 0; i < m_spawn; ++i)
+	{
+		pid_t child = fork();
+		if (child < 0)
+			throw std::runtime_error("cannot fork shard worker");
+		if (child == 0)
+		{
+			int status = 0;
+			try
+			{
+				transport.Close();
+				Serve(*transport.Connect(), m_factory);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "Error:shard worker: " << e.what() << '\n';
+				status = 1;
+			}
+			std::cerr.flush();
+			_exit(status);	// Nothing of the coordinator's state may be flushed or destroyed twice
+		}
+		m_children.push_back(child);
+	}
+#else
+	throw std::runtime_error("sharding is not supported on this platform");
+#endif
+	if (m_spawn < m_numShards)
+		std::cerr << "Waiting for " << (m_numShards - m_spawn) << " shard workers on " << m_address << '\n';
+
+	m_shards.resize(m_numShards);
+	for (auto& shard : m_shards)
+		shard.m_channel = transport.Accept();
+	transport.Close();
+}
+
+/// <summary>
+/// Split the board in to stripes of about equal population and load the workers
+/// </summary>
+/// <param name="board"></param>
+void ShardedSimulator::Load(Board& board)
+{
+	Pattern cells;
+	cells.reserve(board.Size());
+	board.ForEach([&cells](int64_t row, int64_t col) { cells.emplace_back(row, col); return true; });
+	CellCodec::Sort(cells);
+
+	// Stripe k starts at the row of cell k * n / N, rows stay increasing and leave room for the later stripes
+	size_t n = cells.size();
+	for (size_t k = 0; k < m_numShards; ++k)
+	{
+		int64_t top = MIN;
+		if (k > 0)
+		{
+			top = std::max(m_shards[k - 1].m_top + 1, n > 0 ? cells[k * n / m_numShards].m_row : MIN);
+			top = std::min(top, MAX - (int64_t)(m_numShards - 1 - k));
+		}
+		m_shards[k].m_top = top;
+		if (k > 0)
+			m_shards[k - 1].m_bottom = top - 1;
+	}
+	m_shards.back().m_bottom = MAX;
+
+	auto begin = cells.begin();
+	for (auto& shard : m_shards)
+	{
+		auto end = std::upper_bound(begin, cells.end(), shard.m_bottom, [](int64_t row, const BoardState::Cell& cell) { return row < cell.m_row; });
+		std::string message(1, 'L');
+		CellCodec::PutVarint(message, m_engine.size());
+		message += m_engine;
+		PutInt(message, shard.m_top);
+		PutInt(message, shard.m_bottom);
+		CellCodec::Encode(Pattern(begin, end), message);
+		shard.m_channel->Send(message);
+		begin = end;
+	}
+	for (auto& shard : m_shards)
+	{
+		std::string reply;
+		ReceiveReply(*shard.m_channel, reply);
+		MessageReader reader(reply);
+		ReadState(reader, shard.m_top, shard.m_bottom, shard.m_population, shard.m_topRow, shard.m_bottomRow);
+	}
+}
+
+/// <summary>
+/// Step all stripes one generation. All halos are sent before any reply is
+/// read, so the workers step concurrently
+/// </summary>
+void ShardedSimulator::Step()
+{
+	static const Pattern NONE;
+	std::string message;
+	for (size_t i = 0; i < m_shards.size(); ++i)
+	{
+		message.assign(1, 'S');
+		CellCodec::Encode(i > 0 ? m_shards[i - 1].m_bottomRow : NONE, message);
+		CellCodec::Encode(i + 1 < m_shards.size() ? m_shards[i + 1].m_topRow : NONE, message);
+		m_shards[i].m_channel->Send(message);
+	}
+	for (auto& shard : m_shards)
+	{
+		ReceiveReply(*shard.m_channel, message);
+		MessageReader reader(message);
+		ReadState(reader, shard.m_top, shard.m_bottom, shard.m_population, shard.m_topRow, shard.m_bottomRow);
+	}
+}
+
+/// <summary>
+/// Move edge rows holding about count cells from one stripe to its neighbour
+/// </summary>
+/// <param name="from"></param>
+/// <param name="to">:from - 1 or from + 1</param>
+/// <param name="count"></param>
+/// <returns>cells moved</returns>
+uint64_t ShardedSimulator::Move(size_t from, size_t to, uint64_t count)
+{
+	Shard& giver = m_shards[from];
+	Shard& taker = m_shards[to];
+	std::string message(1, 'G');
+	message.push_back(to < from ? 'T' : 'B');
+	CellCodec::PutVarint(message, count);
+	giver.m_channel->Send(message);
+	ReceiveReply(*giver.m_channel, message);
+
+	MessageReader reader(message);
+	Pattern given;
+	reader.GetCells(given);
+	ReadState(reader, giver.m_top, giver.m_bottom, giver.m_population, giver.m_topRow, giver.m_bottomRow);
+	if (given.empty())
+		return 0;
+
+	message.assign(1, 'T');
+	PutInt(message, to < from ? taker.m_top : giver.m_bottom + 1);
+	PutInt(message, to < from ? giver.m_top - 1 : taker.m_bottom);
+	CellCodec::Encode(given, message);
+	taker.m_channel->Send(message);
+	ReceiveReply(*taker.m_channel, message);
+	MessageReader takerReader(message);
+	ReadState(takerReader, taker.m_top, taker.m_bottom, taker.m_population, taker.m_topRow, taker.m_bottomRow);
+	return given.size();
+}
+
+/// <summary>
+/// Move rows across stripe boundaries until every prefix of stripes holds
+/// its share of the population. Cells only cross one boundary per move, so
+/// a crowded stripe far from the empty ones takes a few passes
+/// </summary>
+void ShardedSimulator::Rebalance()
+{
+	uint64_t total = 0, fullest = 0;
+	for (const auto& shard : m_shards)
+	{
+		total += shard.m_population;
+		fullest = std::max(fullest, shard.m_population);
+	}
+	if (m_shards.size() < 2 || (double)fullest <= IMBALANCE * (double)total / (double)m_shards.size())
+		return;
+
+	bool moved = false;
+	int64_t slack = (int64_t)(total / m_shards.size() / 8);
+	for (size_t pass = 0; pass < m_shards.size(); ++pass)
+	{
+		bool passMoved = false;
+		int64_t prefix = 0;
+		for (size_t j = 1; j < m_shards.size(); ++j)
+		{
+			prefix += (int64_t)m_shards[j - 1].m_population;
+			int64_t flow = prefix - (int64_t)(total * j / m_shards.size());
+			if (flow > slack)
+			{
+				uint64_t count = Move(j - 1, j, (uint64_t)flow);
+				prefix -= (int64_t)count;
+				m_stats.m_cellsMoved += count;
+				passMoved |= count != 0;
+			}
+			else if (-flow > slack)
+			{
+				uint64_t count = Move(j, j - 1, (uint64_t)-flow);
+				prefix += (int64_t)count;
+				m_stats.m_cellsMoved += count;
+				passMoved |= count != 0;
+			}
+		}
+		moved |= passMoved;
+		if (!passMoved)
+			break;
+	}
+	if (moved)
+		++m_stats.m_rebalances;
+}
+
+/// <summary>
+/// Gather the stripes back in to the board
+/// </summary>
+/// <param name="board"></param>
+void ShardedSimulator::Collect(Board& board)
+{
+	board.Clear();
+	m_stats.m_populations.clear();
+	std::string message;
+	for (auto& shard : m_shards)
+	{
+		shard.m_channel->Send(std::string(1, 'D'));
+		ReceiveReply(*shard.m_channel, message);
+		MessageReader reader(message);
+		if (reader.GetChar() != 'C')
+			throw std::runtime_error("unexpected shard reply");
+		Pattern cells;
+		reader.GetCells(cells);
+		for (const auto& cell : cells)
+			board.Initialize(cell.m_row, cell.m_col);
+		m_stats.m_populations.push_back(cells.size());
+	}
+}
+
+/// <summary>
+/// Advance the board by a number of generations on the workers
+/// </summary>
+/// <param name="board"></param>
+/// <param name="generations"></param>
+void ShardedSimulator::Run(Board& board, size_t generations)
+{
+	std::unique_ptr<ShardTransport> transport = ShardTransport::Create(m_address);
+	Start(*transport);
+	Load(board);
+	for (size_t i = 0; i < generations; ++i)
+	{
+		Step();
+		if (m_rebalance != 0 && (i + 1) % m_rebalance == 0 && i + 1 < generations)
+			Rebalance();
+	}
+	Collect(board);
+
+	for (auto& shard : m_shards)
+		shard.m_channel->Send(std::string(1, 'Q'));
+	m_shards.clear();
+	Stop();
+}
+
+/// <summary>
+/// Serve a coordinator on a connected channel until it quits or disconnects
+/// </summary>
+/// <param name="channel"></param>
+/// <param name="factory"></param>
+void ShardedSimulator::Serve(ShardChannel& channel, EngineFactory factory)
+{
+	ShardWorker worker(factory);
+	std::string message, reply;
+	while (channel.Receive(message))
+	{
+		reply.clear();
+		try
+		{
+			if (!worker.Execute(message, reply))
+				break;
+		}
+		catch (const std::exception& e)
+		{
+			reply = std::string("E") + e.what();
+		}
+		channel.Send(reply);
+	}
+}
+
+/// <summary>
+/// Connect to a coordinator and serve it
+/// </summary>
+/// <param name="address"></param>
+/// <param name="factory"></param>
+void ShardedSimulator::Work(const std::string& address, EngineFactory factory)
+{
+	std::unique_ptr<ShardTransport> transport = ShardTransport::Create(address);
+	Serve(*transport->Connect(), factory);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Board.h"
+#include "LifeIO.h"
+#include "ShardTransport.h"
+
+/// <summary>
+/// Simulates a board split in to row stripes, each owned by a worker process.
+/// Every generation the coordinator hands each worker the edge rows of its
+/// neighbours (a one cell halo), the worker steps its stripe with the
+/// selected engine and drops what grew outside it, then reports its own new
+/// edge rows. Workers are forked locally or join from other hosts over the
+/// transport (see ShardTransport), e.g. started with --shard-worker.
+/// Stripes are rebalanced as the population shifts by moving whole rows
+/// between neighbouring workers.
+///
+/// Messages, all integers are varints, signed ones zig-zag encoded:
+///   L engine top bottom cells    load a stripe
+///   S above below                halo rows, step one generation
+///   G side count                 give at least count cells from the top (T) or bottom (B) rows
+///   T top bottom cells           take cells and the new stripe bounds
+///   D                            reply with all cells
+///   Q                            quit, no reply
+/// Replies are "R top bottom population topRow bottomRow", preceded by the
+/// given cells for G, "C cells" for D, or "E message" on failure.
+/// </summary>
+class ShardedSimulator
+{
+	public:
+
+		typedef std::function<std::unique_ptr<Board::Visitor>(const std::string& name)> EngineFactory;
+
+		struct Stats
+		{
+			size_t m_rebalances = 0;		// Checks that moved rows
+			uint64_t m_cellsMoved = 0;
+			std::vector<uint64_t> m_populations;	// Per stripe, at the end
+		};
+
+	private:
+
+		/// <summary>
+		/// Coordinator view of one worker
+		/// </summary>
+		struct Shard
+		{
+			std::unique_ptr<ShardChannel> m_channel;
+			int64_t m_top = 0;
+			int64_t m_bottom = 0;
+			uint64_t m_population = 0;
+			Pattern m_topRow;
+			Pattern m_bottomRow;
+		};
+
+		std::string m_address;
+		size_t m_numShards;
+		size_t m_spawn;
+		std::string m_engine;
+		size_t m_rebalance;
+		EngineFactory m_factory;
+		std::vector<Shard> m_shards;
+		std::vector<int> m_children;	// Forked worker processes
+		Stats m_stats;
+
+		void Start(ShardTransport& transport);
+		void Load(Board& board);
+		void Step();
+		void Rebalance();
+		uint64_t Move(size_t from, size_t to, uint64_t count);
+		void Collect(Board& board);
+		void Stop();
+
+	public:
+
+		// address: transport of the workers, empty for a Unix socket in the temp directory
+		// spawn: workers forked here, the others have to join through address
+		// rebalance: generations between rebalancing checks, 0 for fixed stripes
+		ShardedSimulator(EngineFactory factory, const std::string& engine, size_t shards, const std::string& address = "", size_t spawn = (size_t)-1, size_t rebalance = 64);
+		ShardedSimulator(const ShardedSimulator&) = delete;
+		ShardedSimulator& operator=(const ShardedSimulator&) = delete;
+		virtual ~ShardedSimulator();
+
+		// Advance the board by a number of generations. Toggle observers of the board are not notified
+		void Run(Board& board, size_t generations);
+
+		// Worker side: connect to a coordinator and serve it until it quits
+		static void Work(const std::string& address, EngineFactory factory);
+		static void Serve(ShardChannel& channel, EngineFactory factory);
+
+		inline const Stats& GetStats() const
+		{
+			return m_stats;
+		}
+};
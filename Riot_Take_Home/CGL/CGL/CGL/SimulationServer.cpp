@@ -0,0 +1,422 @@
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "LifeIO.h"
+#include "SimulationServer.h"
+
+#if !defined(_WIN32)
+
+/// <summary>
+/// Buffered line I/O on a connected socket
+/// </summary>
+class SimulationServer::Connection
+{
+	private:
+
+		int m_socket = -1;
+		std::string m_buffer;
+		size_t m_pos = 0;
+
+	public:
+
+		Connection(int socket) : m_socket(socket) {}
+
+		/// <summary>
+		/// Read one line without its line break
+		/// </summary>
+		/// <param name="line"></param>
+		/// <returns>false once the peer closed the connection</returns>
+		bool ReadLine(std::string& line)
+		{
+			while (true)
+			{
+				size_t eol = m_buffer.find('\n', m_pos);
+				if (eol != std::string::npos)
+				{
+					line.assign(m_buffer, m_pos, eol - m_pos);
+					m_pos = eol + 1;
+					if (!line.empty() && line.back() == '\r')
+						line.pop_back();
+					return true;
+				}
+				m_buffer.erase(0, m_pos);
+				m_pos = 0;
+
+				char chunk[4096];
+				ssize_t n = recv(m_socket, chunk, sizeof(chunk), 0);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+					return false;
+				m_buffer.append(chunk, static_cast<size_t>(n));
+			}
+		}
+
+		/// <summary>
+		/// Write all of text
+		/// </summary>
+		/// <param name="text"></param>
+		void Write(const std::string& text)
+		{
+#if defined(MSG_NOSIGNAL)
+			const int flags = MSG_NOSIGNAL;	// A client that went away must not kill the server
+#else
+			const int flags = 0;
+#endif
+			size_t sent = 0;
+			while (sent < text.size())
+			{
+				ssize_t n = send(m_socket, text.data() + sent, text.size() - sent, flags);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+					throw std::runtime_error("client connection lost");
+				sent += static_cast<size_t>(n);
+			}
+		}
+};
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="socketPath"></param>
+/// <param name="engineFactory">:creates the update engine of each loaded board</param>
+SimulationServer::SimulationServer(const std::string& socketPath, EngineFactory engineFactory) : m_path(socketPath), m_engineFactory(engineFactory), m_stopping(false)
+{
+	if (!m_engineFactory)
+		throw std::invalid_argument("engine factory cannot be empty");
+}
+
+/// <summary>
+/// dtor
+/// </summary>
+SimulationServer::~SimulationServer()
+{
+	if (m_listener >= 0)
+		close(m_listener);
+}
+
+/// <summary>
+/// Look up a board
+/// </summary>
+/// <param name="name"></param>
+/// <returns></returns>
+std::shared_ptr<SimulationServer::Entry> SimulationServer::Find(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_boardsLock);
+	auto it = m_boards.find(name);
+	if (it == m_boards.end())
+		throw std::invalid_argument("no board named \"" + name + "\"");
+	return it->second;
+}
+
+/// <summary>
+/// Execute one command and write its reply
+/// </summary>
+/// <param name="connection"></param>
+/// <param name="line"></param>
+/// <returns>false if the connection should be closed</returns>
+bool SimulationServer::Execute(Connection& connection, const std::string& line)
+{
+	std::istringstream args(line);
+	std::string command, name;
+	args >> command >> name;
+	std::ostringstream reply;
+
+	if (command.empty())
+		return true;
+	if (command == "QUIT")
+	{
+		connection.Write("OK\n");
+		return false;
+	}
+	if (command == "SHUTDOWN")
+	{
+		connection.Write("OK\n");
+		Stop();
+		return false;
+	}
+	if (command == "LIST")
+	{
+		std::vector<std::pair<std::string, std::shared_ptr<Entry>>> boards;
+		{
+			std::lock_guard<std::mutex> lock(m_boardsLock);
+			boards.assign(m_boards.begin(), m_boards.end());
+		}
+		reply << "OK " << boards.size() << '\n';
+		for (auto& board : boards)
+		{
+			std::lock_guard<std::mutex> lock(board.second->m_lock);
+			reply << board.first << ' ' << board.second->m_generation << ' ' << board.second->m_board.Size() << '\n';
+		}
+		reply << ".\n";
+		connection.Write(reply.str());
+		return true;
+	}
+	if (name.empty())
+		throw std::invalid_argument("missing board name");
+
+	if (command == "LOAD")
+	{
+		// Build the board before taking any lock, readers of an older board with this name are not blocked
+		std::shared_ptr<Entry> entry(new Entry());
+		entry->m_engine = m_engineFactory();
+		std::string cellLine;
+		size_t count = 0;
+		std::string error;
+		while (connection.ReadLine(cellLine) && cellLine != ".")
+		{
+			if (cellLine == LIFE_106_HEADER || (!cellLine.empty() && cellLine[0] == '#'))
+				continue;
+			int64_t row = 0, col = 0;
+			try
+			{
+				if (!ParseCell(cellLine, row, col))
+					break;
+			}
+			catch (const std::exception& e)
+			{
+				// Keep reading to the end of the cell list so the connection stays in sync
+				if (error.empty())
+					error = e.what();
+				continue;
+			}
+			entry->m_board.Initialize(row, col);
+			++count;
+		}
+		if (!error.empty())
+			throw std::invalid_argument(error);
+		{
+			std::lock_guard<std::mutex> lock(m_boardsLock);
+			m_boards[name] = entry;
+		}
+		reply << "OK " << entry->m_board.Size() << '\n';
+	}
+	else if (command == "FORK")
+	{
+		std::string forkName;
+		if (!(args >> forkName))
+			throw std::invalid_argument("missing name of the fork");
+		std::shared_ptr<Entry> source = Find(name);
+		std::shared_ptr<Entry> entry(new Entry());
+		entry->m_engine = m_engineFactory();
+		{
+			std::lock_guard<std::mutex> lock(source->m_lock);
+			entry->m_board = source->m_board.Fork();
+			entry->m_generation = source->m_generation;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_boardsLock);
+			m_boards[forkName] = entry;
+		}
+		reply << "OK " << entry->m_board.Size() << '\n';
+	}
+	else if (command == "DROP")
+	{
+		std::lock_guard<std::mutex> lock(m_boardsLock);
+		if (m_boards.erase(name) == 0)
+			throw std::invalid_argument("no board named \"" + name + "\"");
+		reply << "OK\n";
+	}
+	else if (command == "STEP")
+	{
+		uint64_t steps = 1;
+		std::string count;
+		if (args >> count)
+		{
+			if (count.find_first_not_of("0123456789") != std::string::npos || count.size() > 19 || (steps = std::stoull(count)) > MAX_STEPS)
+				throw std::invalid_argument("STEP count must be a number from 0 to " + std::to_string(MAX_STEPS));
+		}
+
+		// The lock is taken per generation, so other requests on the board get in between
+		std::shared_ptr<Entry> entry = Find(name);
+		for (uint64_t i = 0; i < steps && !m_stopping; ++i)
+		{
+			std::lock_guard<std::mutex> lock(entry->m_lock);
+			entry->m_board.Accept(entry->m_engine.get());
+			++entry->m_generation;
+		}
+		std::lock_guard<std::mutex> lock(entry->m_lock);
+		reply << "OK " << entry->m_generation << ' ' << entry->m_board.Size() << '\n';
+	}
+	else if (command == "POP")
+	{
+		std::shared_ptr<Entry> entry = Find(name);
+		std::lock_guard<std::mutex> lock(entry->m_lock);
+		reply << "OK " << entry->m_board.Size() << ' ' << entry->m_generation << '\n';
+	}
+	else if (command == "BOUNDS")
+	{
+		std::shared_ptr<Entry> entry = Find(name);
+		std::lock_guard<std::mutex> lock(entry->m_lock);
+		int64_t top, left, bottom, right;
+		if (entry->m_board.GetBounds(top, left, bottom, right))
+			reply << "OK " << top << ' ' << left << ' ' << bottom << ' ' << right << '\n';
+		else
+			reply << "OK empty\n";
+	}
+	else if (command == "REGION" || command == "SNAPSHOT")
+	{
+		int64_t top = std::numeric_limits<int64_t>::min(), left = std::numeric_limits<int64_t>::min();
+		int64_t bottom = std::numeric_limits<int64_t>::max(), right = std::numeric_limits<int64_t>::max();
+		if (command == "REGION" && !(args >> top >> left >> bottom >> right))
+			throw std::invalid_argument("REGION needs top left bottom right");
+
+		// REGION only walks the rows and columns of its box, not the whole board
+		std::ostringstream cells;
+		size_t count = 0;
+		std::shared_ptr<Entry> entry = Find(name);
+		{
+			std::lock_guard<std::mutex> lock(entry->m_lock);
+			entry->m_board.ForEachIn(top, left, bottom, right, [&cells, &count](int64_t row, int64_t col)
+			{
+				cells << row << ' ' << col << '\n';
+				++count;
+				return true;
+			});
+		}
+		reply << "OK " << count << '\n';
+		if (command == "SNAPSHOT")
+			reply << LIFE_106_HEADER << '\n';
+		reply << cells.str() << ".\n";
+	}
+	else
+	{
+		throw std::invalid_argument("unknown command \"" + command + "\"");
+	}
+
+	connection.Write(reply.str());
+	return true;
+}
+
+/// <summary>
+/// Serve one client until it disconnects
+/// </summary>
+/// <param name="client"></param>
+void SimulationServer::Serve(int client)
+{
+	Connection connection(client);
+	std::string line;
+	try
+	{
+		while (connection.ReadLine(line))
+		{
+			try
+			{
+				if (!Execute(connection, line))
+					break;
+			}
+			catch (const std::exception& e)
+			{
+				connection.Write(std::string("ERR ") + e.what() + '\n');
+			}
+		}
+	}
+	catch (const std::exception&)
+	{
+		// Connection lost while replying, nothing left to tell the client
+	}
+
+	std::lock_guard<std::mutex> lock(m_clientsLock);
+	m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), client), m_clients.end());
+	close(client);
+	m_clientsDone.notify_all();
+}
+
+/// <summary>
+/// Stop accepting and wake up all connection threads
+/// </summary>
+void SimulationServer::Stop()
+{
+	m_stopping = true;
+	shutdown(m_listener, SHUT_RDWR);
+	std::lock_guard<std::mutex> lock(m_clientsLock);
+	for (int client : m_clients)
+		shutdown(client, SHUT_RD);
+}
+
+/// <summary>
+/// Listen on the socket path and serve clients
+/// </summary>
+void SimulationServer::Run()
+{
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (m_path.empty() || m_path.size() >= sizeof(addr.sun_path))
+		throw std::invalid_argument("invalid socket path \"" + m_path + "\"");
+	std::memcpy(addr.sun_path, m_path.c_str(), m_path.size());
+
+	m_listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_listener < 0)
+		throw std::runtime_error("cannot create socket");
+	unlink(m_path.c_str());	// Stale socket of an earlier run
+	if (bind(m_listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(m_listener, SOMAXCONN) != 0)
+		throw std::runtime_error("cannot listen on \"" + m_path + "\": " + std::strerror(errno));
+
+	while (!m_stopping)
+	{
+		int client = accept(m_listener, nullptr, nullptr);
+		if (client < 0)
+		{
+			if (m_stopping)
+				break;
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			throw std::runtime_error(std::string("accept failed: ") + std::strerror(errno));
+		}
+
+		std::lock_guard<std::mutex> lock(m_clientsLock);
+		if (m_stopping)
+		{
+			close(client);
+			break;
+		}
+		m_clients.push_back(client);
+		std::thread(&SimulationServer::Serve, this, client).detach();
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_clientsLock);
+		m_clientsDone.wait(lock, [this]() { return m_clients.empty(); });
+	}
+	close(m_listener);
+	m_listener = -1;
+	unlink(m_path.c_str());
+}
+
+#else
+
+class SimulationServer::Connection
+{
+};
+
+SimulationServer::SimulationServer(const std::string& socketPath, EngineFactory engineFactory) : m_path(socketPath), m_engineFactory(engineFactory), m_stopping(false)
+{
+}
+
+SimulationServer::~SimulationServer()
+{
+}
+
+/// <summary>
+/// Unix domain sockets are not available on this platform
+/// </summary>
+void SimulationServer::Run()
+{
+	throw std::runtime_error("server mode is not supported on this platform");
+}
+
+#endif
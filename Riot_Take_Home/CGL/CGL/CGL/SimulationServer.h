@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Board.h"
+
+/// <summary>
+/// Long running server keeping named boards resident between requests.
+/// Clients connect over a Unix domain socket and send line based commands;
+/// every connection is served on its own thread and requests on different
+/// boards run concurrently, requests on the same board are serialized.
+///
+/// Commands, replies start with "OK" or "ERR message":
+///   LOAD name                      followed by "row col" lines, ended by a "." or blank line
+///   STEP name [n]                  OK generation population, n from 0 to MAX_STEPS (default 1)
+///   POP name                       OK population generation
+///   BOUNDS name                    OK top left bottom right, or OK empty
+///   REGION name top left bottom right   OK count, then one "row col" line per cell and ".",
+///                                  costs the rows and columns of the box rather than the population
+///   SNAPSHOT name                  OK count, then the board in Life 1.06 format and "."
+///   FORK name new                  OK population, new starts as a copy of name sharing its cells
+///   DROP name
+///   LIST                           OK count, then one "name generation population" line per board and "."
+///   QUIT                           close this connection
+///   SHUTDOWN                       stop the server
+/// </summary>
+class SimulationServer
+{
+	public:
+
+		typedef std::function<std::unique_ptr<Board::Visitor>()> EngineFactory;
+
+		static const uint64_t MAX_STEPS = 1000000;
+
+	private:
+
+		/// <summary>
+		/// A resident board with its engine, the engine's caches stay warm between requests
+		/// </summary>
+		struct Entry
+		{
+			std::mutex m_lock;
+			Board m_board;
+			std::unique_ptr<Board::Visitor> m_engine;
+			uint64_t m_generation = 0;
+		};
+
+		class Connection;
+
+		std::string m_path;
+		EngineFactory m_engineFactory;
+		std::map<std::string, std::shared_ptr<Entry>> m_boards;
+		std::mutex m_boardsLock;
+		std::atomic<bool> m_stopping;
+		int m_listener = -1;
+		std::vector<int> m_clients;		// Open client sockets, each served by a detached thread
+		std::mutex m_clientsLock;
+		std::condition_variable m_clientsDone;
+
+		std::shared_ptr<Entry> Find(const std::string& name);
+		void Serve(int client);
+		bool Execute(Connection& connection, const std::string& line);
+		void Stop();
+
+	public:
+
+		SimulationServer(const std::string& socketPath, EngineFactory engineFactory);
+		SimulationServer(const SimulationServer&) = delete;
+		SimulationServer& operator=(const SimulationServer&) = delete;
+		virtual ~SimulationServer();
+
+		// Listen and serve until a SHUTDOWN command is received
+		void Run();
+};
@@ -0,0 +1,455 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "BoardUpdater.h"
+#include "Census.h"
+#include "SpaceshipTracker.h"
+
+namespace
+{
+	const int64_t MAX = std::numeric_limits<int64_t>::max();
+	const int64_t MIN = std::numeric_limits<int64_t>::min();
+
+	// Cells further apart than 2 can not affect each other's next generation
+	const uint64_t SAFE_DISTANCE = 3;
+
+	/// <summary>
+	/// A known spaceship, drawn with '*' for live cells
+	/// </summary>
+	struct KnownShip
+	{
+		const char* m_name;
+		size_t m_period;
+		std::vector<const char*> m_rows;
+	};
+
+	const std::vector<KnownShip>& KnownShips()
+	{
+		static const std::vector<KnownShip> ships =
+		{
+			{ "glider", 4, { ".*.", "..*", "***" } },
+			{ "LWSS", 4, { ".*..*", "*....", "*...*", "****." } },
+			{ "MWSS", 4, { "...*..", ".*...*", "*.....", "*....*", "*****." } },
+			{ "HWSS", 4, { "...**..", ".*....*", "*......", "*.....*", "******." } },
+		};
+		return ships;
+	}
+
+	/// <summary>
+	/// Empty cells between two boxes along the axis where they are furthest apart, plus one
+	/// </summary>
+	template <typename B>
+	uint64_t Gap(const B& a, const B& b)
+	{
+		uint64_t rows = 0, cols = 0;
+		if (a.m_top > b.m_bottom)
+			rows = (uint64_t)a.m_top - (uint64_t)b.m_bottom;
+		else if (b.m_top > a.m_bottom)
+			rows = (uint64_t)b.m_top - (uint64_t)a.m_bottom;
+		if (a.m_left > b.m_right)
+			cols = (uint64_t)a.m_left - (uint64_t)b.m_right;
+		else if (b.m_left > a.m_right)
+			cols = (uint64_t)b.m_left - (uint64_t)a.m_right;
+		return std::max(rows, cols);
+	}
+
+	/// <summary>
+	/// Grow a bounding box to include another, any: whether box holds anything yet
+	/// </summary>
+	template <typename B>
+	void Extend(B& box, bool& any, const B& other)
+	{
+		if (!any)
+		{
+			box = other;
+			any = true;
+			return;
+		}
+		box.m_top = std::min(box.m_top, other.m_top);
+		box.m_bottom = std::max(box.m_bottom, other.m_bottom);
+		box.m_left = std::min(box.m_left, other.m_left);
+		box.m_right = std::max(box.m_right, other.m_right);
+	}
+
+	/// <summary>
+	/// Distance of a box to the nearest row or column beyond the INT64 range
+	/// </summary>
+	template <typename B>
+	uint64_t WallGap(const B& box)
+	{
+		uint64_t gap = std::min((uint64_t)box.m_top - (uint64_t)MIN, (uint64_t)MAX - (uint64_t)box.m_bottom);
+		gap = std::min(gap, std::min((uint64_t)box.m_left - (uint64_t)MIN, (uint64_t)MAX - (uint64_t)box.m_right));
+		return gap == std::numeric_limits<uint64_t>::max() ? gap : gap + 1;
+	}
+}
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="interval">:generations between captures</param>
+/// <param name="numThreads">:threads splitting the board, 0 for hardware concurrency</param>
+SpaceshipTracker::SpaceshipTracker(size_t interval, size_t numThreads) : m_interval(interval), m_numThreads(numThreads)
+{
+	if (m_interval == 0)
+		throw std::invalid_argument("capture interval cannot be 0");
+	BuildCourses();
+}
+
+/// <summary>
+/// Cells moved so their bounding box starts at 0, 0, sorted
+/// </summary>
+/// <param name="cells"></param>
+/// <param name="top">:set to the bounding box top</param>
+/// <param name="left">:set to the bounding box left</param>
+/// <returns></returns>
+SpaceshipTracker::ShapeKey SpaceshipTracker::KeyOf(const Pattern& cells, int64_t& top, int64_t& left)
+{
+	top = left = 0;
+	if (cells.empty())
+		return ShapeKey();
+	top = cells[0].m_row;
+	left = cells[0].m_col;
+	for (const auto& cell : cells)
+	{
+		top = std::min(top, cell.m_row);
+		left = std::min(left, cell.m_col);
+	}
+	ShapeKey key;
+	key.reserve(cells.size());
+	for (const auto& cell : cells)
+		key.emplace_back((int64_t)((uint64_t)cell.m_row - (uint64_t)top), (int64_t)((uint64_t)cell.m_col - (uint64_t)left));
+	std::sort(key.begin(), key.end());
+	return key;
+}
+
+/// <summary>
+/// Simulate every orientation of every known ship for a period, recording its phases and displacement
+/// </summary>
+void SpaceshipTracker::BuildCourses()
+{
+	Board board;
+	BoardUpdater updater;
+	Pattern cells;
+	for (const auto& known : KnownShips())
+	{
+		for (int transform = 0; transform < 8; ++transform)
+		{
+			// Rows and columns are mirrored and swapped around the drawing's origin
+			board.Clear();
+			for (size_t r = 0; r < known.m_rows.size(); ++r)
+			{
+				for (size_t c = 0; known.m_rows[r][c] != '\0'; ++c)
+				{
+					if (known.m_rows[r][c] != '*')
+						continue;
+					int64_t row = (transform & 1) ? -(int64_t)r : (int64_t)r;
+					int64_t col = (transform & 2) ? -(int64_t)c : (int64_t)c;
+					if (transform & 4)
+						std::swap(row, col);
+					board.Initialize(row, col);
+				}
+			}
+
+			// Orientations that are a phase of an earlier one share its course
+			cells.clear();
+			board.ForEach([&cells](int64_t row, int64_t col) { cells.emplace_back(row, col); return true; });
+			int64_t top = 0, left = 0;
+			if (m_shapes.count(KeyOf(cells, top, left)) != 0)
+				continue;
+
+			Course course;
+			course.m_name = known.m_name;
+			for (size_t phase = 0; phase <= known.m_period; ++phase)
+			{
+				cells.clear();
+				board.ForEach([&cells](int64_t row, int64_t col) { cells.emplace_back(row, col); return true; });
+				ShapeKey key = KeyOf(cells, top, left);
+				if (phase == known.m_period)
+				{
+					if (key != KeyOf(course.m_phases[0], course.m_dRow, course.m_dCol))
+						throw std::logic_error(course.m_name + " does not repeat after its period");
+					course.m_dRow = top - course.m_dRow;
+					course.m_dCol = left - course.m_dCol;
+					break;
+				}
+
+				Box box;
+				box.m_top = box.m_bottom = cells[0].m_row;
+				box.m_left = box.m_right = cells[0].m_col;
+				for (const auto& cell : cells)
+				{
+					box.m_top = std::min(box.m_top, cell.m_row);
+					box.m_bottom = std::max(box.m_bottom, cell.m_row);
+					box.m_left = std::min(box.m_left, cell.m_col);
+					box.m_right = std::max(box.m_right, cell.m_col);
+				}
+				course.m_phases.push_back(cells);
+				course.m_boxes.push_back(box);
+				m_shapes.emplace(key, Shape{ m_courses.size(), phase });
+				m_maxShapeCells = std::max(m_maxShapeCells, cells.size());
+				board.Accept(&updater);
+			}
+			if (course.m_dRow == 0 && course.m_dCol == 0)
+				throw std::logic_error(course.m_name + " does not move");
+			m_courses.push_back(course);
+		}
+	}
+}
+
+/// <summary>
+/// Bounding box of a tracked ship at a generation
+/// </summary>
+/// <param name="ship"></param>
+/// <param name="generation">:not before the ship's start</param>
+/// <returns></returns>
+SpaceshipTracker::Box SpaceshipTracker::BoxAt(const Ship& ship, uint64_t generation) const
+{
+	const Course& course = m_courses[ship.m_course];
+	uint64_t step = ship.m_phase + (generation - ship.m_start);
+	uint64_t periods = step / course.m_phases.size();
+	const Box& phase = course.m_boxes[step % course.m_phases.size()];
+	uint64_t row = (uint64_t)ship.m_row + periods * (uint64_t)course.m_dRow;
+	uint64_t col = (uint64_t)ship.m_col + periods * (uint64_t)course.m_dCol;
+
+	Box box;
+	box.m_top = (int64_t)(row + (uint64_t)phase.m_top);
+	box.m_bottom = (int64_t)(row + (uint64_t)phase.m_bottom);
+	box.m_left = (int64_t)(col + (uint64_t)phase.m_left);
+	box.m_right = (int64_t)(col + (uint64_t)phase.m_right);
+	return box;
+}
+
+/// <summary>
+/// Cells of a tracked ship at a generation
+/// </summary>
+/// <param name="ship"></param>
+/// <param name="generation">:not before the ship's start</param>
+/// <param name="cells">:appended to</param>
+void SpaceshipTracker::CellsAt(const Ship& ship, uint64_t generation, Pattern& cells) const
+{
+	const Course& course = m_courses[ship.m_course];
+	uint64_t step = ship.m_phase + (generation - ship.m_start);
+	uint64_t periods = step / course.m_phases.size();
+	uint64_t row = (uint64_t)ship.m_row + periods * (uint64_t)course.m_dRow;
+	uint64_t col = (uint64_t)ship.m_col + periods * (uint64_t)course.m_dCol;
+	for (const auto& cell : course.m_phases[step % course.m_phases.size()])
+		cells.emplace_back((int64_t)(row + (uint64_t)cell.m_row), (int64_t)(col + (uint64_t)cell.m_col));
+}
+
+/// <summary>
+/// Take isolated known ships that move out of the bounding box of all other components off the board
+/// </summary>
+/// <param name="board"></param>
+void SpaceshipTracker::Capture(Board& board)
+{
+	// Components at least 4 cells apart, so a lone ship can not touch anything next generation
+	Census census(SAFE_DISTANCE - 1, m_numThreads);
+	std::vector<Pattern> parts = census.Components(board);
+
+	struct Candidate
+	{
+		size_t m_part;
+		Shape m_shape;
+		Box m_box;
+	};
+	std::vector<Candidate> candidates;
+	Box rest;
+	bool anyRest = false;
+	for (size_t i = 0; i < parts.size(); ++i)
+	{
+		const Pattern& part = parts[i];
+		int64_t top = 0, left = 0;
+		std::map<ShapeKey, Shape>::const_iterator shape = m_shapes.end();
+		if (part.size() <= m_maxShapeCells)
+			shape = m_shapes.find(KeyOf(part, top, left));
+
+		Box box;
+		box.m_top = box.m_bottom = part[0].m_row;
+		box.m_left = box.m_right = part[0].m_col;
+		for (const auto& cell : part)
+		{
+			box.m_top = std::min(box.m_top, cell.m_row);
+			box.m_bottom = std::max(box.m_bottom, cell.m_row);
+			box.m_left = std::min(box.m_left, cell.m_col);
+			box.m_right = std::max(box.m_right, cell.m_col);
+		}
+		if (shape != m_shapes.end())
+		{
+			candidates.push_back(Candidate{ i, shape->second, box });
+			continue;
+		}
+		Extend(rest, anyRest, box);
+	}
+
+	// Escaping ships are tracked tentatively, then those too close to the core,
+	// a wall or another ship go back to the core until all left pass Check's test
+	std::vector<std::pair<uint64_t, size_t>> tracked;
+	Box core = rest;
+	bool anyCore = anyRest;
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		const Candidate& candidate = candidates[i];
+		const Course& course = m_courses[candidate.m_shape.m_course];
+		const Box& box = candidate.m_box;
+		bool escaping = !anyRest
+			|| (course.m_dRow > 0 && box.m_top > rest.m_bottom) || (course.m_dRow < 0 && box.m_bottom < rest.m_top)
+			|| (course.m_dCol > 0 && box.m_left > rest.m_right) || (course.m_dCol < 0 && box.m_right < rest.m_left);
+		if (!escaping)
+		{
+			Extend(core, anyCore, box);
+			continue;
+		}
+
+		const Box& phase = course.m_boxes[candidate.m_shape.m_phase];
+		Ship ship;
+		ship.m_course = candidate.m_shape.m_course;
+		ship.m_phase = candidate.m_shape.m_phase;
+		ship.m_row = (int64_t)((uint64_t)box.m_top - (uint64_t)phase.m_top);
+		ship.m_col = (int64_t)((uint64_t)box.m_left - (uint64_t)phase.m_left);
+		ship.m_start = m_generation;
+		m_ships.emplace(m_nextId, ship);
+		tracked.emplace_back(m_nextId++, i);
+	}
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (size_t i = 0; i < tracked.size(); ++i)
+		{
+			if (Clearance(tracked[i].first, anyCore ? &core : nullptr) >= SAFE_DISTANCE)
+				continue;
+			m_ships.erase(tracked[i].first);
+			Extend(core, anyCore, candidates[tracked[i].second].m_box);
+			tracked[i] = tracked.back();
+			tracked.pop_back();
+			changed = true;
+			break;
+		}
+	}
+
+	for (const auto& ship : tracked)
+	{
+		for (const auto& cell : parts[candidates[ship.second].m_part])
+			board.QueueToggle(cell.m_row, cell.m_col);
+		m_checks.emplace(m_generation, ship.first);
+		++m_stats.m_captured;
+	}
+	if (!tracked.empty())
+		board.ApplyToggles();
+}
+
+/// <summary>
+/// Distance of a tracked ship to the core, the INT64 walls and the other
+/// tracked ships. Ships on the same course keep their placement, so they
+/// only count if they come within range during one period
+/// </summary>
+/// <param name="id"></param>
+/// <param name="core">:bounding box of the board, null if it is empty</param>
+/// <returns></returns>
+uint64_t SpaceshipTracker::Clearance(uint64_t id, const Box* core) const
+{
+	const Ship& ship = m_ships.at(id);
+	Box box = BoxAt(ship, m_generation);
+	uint64_t distance = WallGap(box);
+	if (core != nullptr)
+		distance = std::min(distance, Gap(box, *core));
+	for (auto other = m_ships.begin(); other != m_ships.end() && distance >= SAFE_DISTANCE; ++other)
+	{
+		if (other->first == id)
+			continue;
+		if (other->second.m_course != ship.m_course)
+		{
+			distance = std::min(distance, Gap(box, BoxAt(other->second, m_generation)));
+			continue;
+		}
+
+		uint64_t closest = std::numeric_limits<uint64_t>::max();
+		for (uint64_t t = 0; t < m_courses[ship.m_course].m_phases.size(); ++t)
+			closest = std::min(closest, Gap(BoxAt(ship, m_generation + t), BoxAt(other->second, m_generation + t)));
+		if (closest < SAFE_DISTANCE)
+			distance = closest;
+	}
+	return distance;
+}
+
+/// <summary>
+/// Put a tracked ship back on the board
+/// </summary>
+/// <param name="board"></param>
+/// <param name="id"></param>
+void SpaceshipTracker::Release(Board& board, uint64_t id)
+{
+	auto it = m_ships.find(id);
+	Pattern cells;
+	CellsAt(it->second, m_generation, cells);
+	for (const auto& cell : cells)
+		board.Initialize(cell.m_row, cell.m_col);
+	m_ships.erase(it);
+}
+
+/// <summary>
+/// Check the ships that are due: release those that could interact, schedule
+/// the others by how long their distance lasts at a closing speed of 2 cells
+/// per generation. A release moves the core's bounds at once, so it makes all
+/// ships due again
+/// </summary>
+/// <param name="board"></param>
+void SpaceshipTracker::Check(Board& board)
+{
+	bool haveCore = false, coreEmpty = true;
+	Box core;
+	while (!m_checks.empty() && m_checks.begin()->first <= m_generation)
+	{
+		uint64_t id = m_checks.begin()->second;
+		m_checks.erase(m_checks.begin());
+		if (m_ships.count(id) == 0)
+			continue;
+		if (!haveCore)
+		{
+			coreEmpty = !board.GetBounds(core.m_top, core.m_left, core.m_bottom, core.m_right);
+			haveCore = true;
+		}
+
+		uint64_t distance = Clearance(id, coreEmpty ? nullptr : &core);
+		if (distance < SAFE_DISTANCE)
+		{
+			Release(board, id);
+			++m_stats.m_released;
+			haveCore = false;
+			m_checks.clear();
+			for (const auto& tracked : m_ships)
+				m_checks.emplace(m_generation, tracked.first);
+			continue;
+		}
+		uint64_t wait = std::max<uint64_t>(1, (distance - SAFE_DISTANCE) / 2);
+		m_checks.emplace(wait > std::numeric_limits<uint64_t>::max() - m_generation ? std::numeric_limits<uint64_t>::max() : m_generation + wait, id);
+	}
+}
+
+/// <summary>
+/// Move to the next generation: capture every interval, then check the ships that are due
+/// </summary>
+/// <param name="board">:already stepped</param>
+void SpaceshipTracker::Advance(Board& board)
+{
+	++m_generation;
+	if (m_generation % m_interval == 0)
+		Capture(board);
+	Check(board);
+	m_stats.m_maxTracked = std::max(m_stats.m_maxTracked, m_ships.size());
+}
+
+/// <summary>
+/// Put all tracked ships back on the board
+/// </summary>
+/// <param name="board"></param>
+void SpaceshipTracker::ReleaseAll(Board& board)
+{
+	Pattern cells;
+	for (const auto& tracked : m_ships)
+		CellsAt(tracked.second, m_generation, cells);
+	for (const auto& cell : cells)
+		board.Initialize(cell.m_row, cell.m_col);
+	m_ships.clear();
+	m_checks.clear();
+}
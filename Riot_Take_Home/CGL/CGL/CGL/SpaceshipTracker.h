@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Board.h"
+#include "LifeIO.h"
+
+/// <summary>
+/// Takes known spaceships (glider, LWSS, MWSS, HWSS in every phase and
+/// orientation) that fly away from the rest of the board off the board and
+/// moves them analytically, so the engine only steps the active core.
+/// Every interval generations the board is split in to components and
+/// isolated spaceships moving out of the bounding box of everything else are
+/// captured if they are out of interaction range. A tracked ship is put back on the board as soon as it could come
+/// within interaction range (2 cells) of the core, another ship or an INT64
+/// wall. Since bounding boxes grow at most one cell per generation, a ship
+/// at distance d is only checked again after (d - 3) / 2 generations, so
+/// escaped ships cost next to nothing per generation.
+/// </summary>
+class SpaceshipTracker
+{
+	public:
+
+		struct Stats
+		{
+			size_t m_captured = 0;
+			size_t m_released = 0;			// Put back on the board before the end
+			size_t m_maxTracked = 0;
+		};
+
+	private:
+
+		/// <summary>
+		/// Bounding box of cells
+		/// </summary>
+		struct Box
+		{
+			int64_t m_top = 0;
+			int64_t m_left = 0;
+			int64_t m_bottom = 0;
+			int64_t m_right = 0;
+		};
+
+		/// <summary>
+		/// One orientation of a known spaceship, phases are relative to a course
+		/// origin that moves by the displacement every period
+		/// </summary>
+		struct Course
+		{
+			std::string m_name;
+			std::vector<Pattern> m_phases;
+			std::vector<Box> m_boxes;		// Of every phase
+			int64_t m_dRow = 0;
+			int64_t m_dCol = 0;
+		};
+
+		/// <summary>
+		/// A phase of a course, looked up by its cells moved to 0, 0
+		/// </summary>
+		struct Shape
+		{
+			size_t m_course = 0;
+			size_t m_phase = 0;
+		};
+
+		/// <summary>
+		/// A tracked ship: course, its phase and origin at the start generation
+		/// </summary>
+		struct Ship
+		{
+			size_t m_course = 0;
+			size_t m_phase = 0;
+			int64_t m_row = 0;
+			int64_t m_col = 0;
+			uint64_t m_start = 0;
+		};
+
+		typedef std::vector<std::pair<int64_t, int64_t>> ShapeKey;
+
+		size_t m_interval;
+		size_t m_numThreads;
+		std::vector<Course> m_courses;
+		std::map<ShapeKey, Shape> m_shapes;
+		size_t m_maxShapeCells = 0;
+		std::unordered_map<uint64_t, Ship> m_ships;
+		std::multimap<uint64_t, uint64_t> m_checks;	// Generation to ship id, stale ids are skipped
+		uint64_t m_nextId = 0;
+		uint64_t m_generation = 0;
+		Stats m_stats;
+
+		static ShapeKey KeyOf(const Pattern& cells, int64_t& top, int64_t& left);
+		void BuildCourses();
+		Box BoxAt(const Ship& ship, uint64_t generation) const;
+		void CellsAt(const Ship& ship, uint64_t generation, Pattern& cells) const;
+		uint64_t Clearance(uint64_t id, const Box* core) const;
+		void Capture(Board& board);
+		void Check(Board& board);
+		void Release(Board& board, uint64_t id);
+
+	public:
+
+		// interval: generations between captures, numThreads: for splitting the board, 0 for hardware concurrency
+		SpaceshipTracker(size_t interval, size_t numThreads = 0);
+
+		// Call after every generation of the board
+		void Advance(Board& board);
+		// Put all tracked ships back on the board, e.g. before output
+		void ReleaseAll(Board& board);
+
+		inline size_t Tracked() const
+		{
+			return m_ships.size();
+		}
+
+		inline const Stats& GetStats() const
+		{
+			return m_stats;
+		}
+};
@@ -0,0 +1,317 @@
+
+#include <cstring>
+#include <stdexcept>
+
+#include "BitOps.h"
+#include "TilePageStore.h"
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="path"></param>
+/// <param name="residentBytes">:memory for mapped in tiles</param>
+TilePageStore::TilePageStore(const std::string& path, size_t residentBytes) : m_maxResident(residentBytes / CHUNK_BYTES)
+{
+	if (m_maxResident == 0)
+		m_maxResident = 1;
+	if (CHUNK_BYTES % MappedFile::Granularity() != 0)
+		throw std::runtime_error("tile chunk size is not a multiple of the mapping granularity");
+	m_file.Create(path, true);
+}
+
+/// <summary>
+/// dtor
+/// </summary>
+TilePageStore::~TilePageStore()
+{
+	for (auto& chunk : m_chunks)
+		MappedFile::Unmap(chunk.m_tiles, CHUNK_BYTES);
+}
+
+/// <summary>
+/// Address of a tile slot, mapping its chunk in if needed. The chunk moves to
+/// the front of the resident list; going over the resident budget drops the
+/// chunk at its back
+/// </summary>
+/// <param name="slot"></param>
+/// <returns></returns>
+uint64_t* TilePageStore::Tile(uint32_t slot) const
+{
+	uint32_t index = static_cast<uint32_t>(slot / CHUNK_TILES);
+	Chunk& chunk = m_chunks[index];
+	if (m_newest != index)
+	{
+		if (chunk.m_resident)
+			Unlink(index);
+		else
+			++m_resident;
+		chunk.m_resident = true;
+		chunk.m_older = m_newest;
+		chunk.m_newer = NO_CHUNK;
+		if (m_newest != NO_CHUNK)
+			m_chunks[m_newest].m_newer = index;
+		m_newest = index;
+		if (m_oldest == NO_CHUNK)
+			m_oldest = index;
+		if (m_resident > m_maxResident)
+			EvictOldest();
+	}
+	return chunk.m_tiles + (slot % CHUNK_TILES) * TILE_SIZE;
+}
+
+/// <summary>
+/// Take a resident chunk out of the resident list
+/// </summary>
+/// <param name="index"></param>
+void TilePageStore::Unlink(uint32_t index) const
+{
+	Chunk& chunk = m_chunks[index];
+	if (chunk.m_newer != NO_CHUNK)
+		m_chunks[chunk.m_newer].m_older = chunk.m_older;
+	else
+		m_newest = chunk.m_older;
+	if (chunk.m_older != NO_CHUNK)
+		m_chunks[chunk.m_older].m_newer = chunk.m_newer;
+	else
+		m_oldest = chunk.m_newer;
+	chunk.m_newer = chunk.m_older = NO_CHUNK;
+}
+
+/// <summary>
+/// Write back and drop the resident chunk used longest ago
+/// </summary>
+void TilePageStore::EvictOldest() const
+{
+	uint32_t index = m_oldest;
+	Unlink(index);
+	Chunk& chunk = m_chunks[index];
+	MappedFile::Evict(chunk.m_tiles, CHUNK_BYTES);
+	chunk.m_resident = false;
+	--m_resident;
+}
+
+/// <summary>
+/// Find the tile holding row, col
+/// </summary>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <param name="it">:index entry of the tile</param>
+/// <returns>tile rows, null if there is no such tile</returns>
+uint64_t* TilePageStore::FindTile(int64_t row, int64_t col, Index::iterator& it)
+{
+	it = m_index.find(TileKey(row >> TILE_SHIFT, col >> TILE_SHIFT));
+	if (it == m_index.end())
+		return nullptr;
+	return Tile(it->second.m_slot);
+}
+
+/// <summary>
+/// Add an empty tile for row, col, growing the file by a chunk when full
+/// </summary>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns></returns>
+TilePageStore::Index::iterator TilePageStore::CreateTile(int64_t row, int64_t col)
+{
+	uint32_t slot = 0;
+	if (!m_freeSlots.empty())
+	{
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else
+	{
+		if (m_nextSlot == m_chunks.size() * CHUNK_TILES)
+		{
+			uint64_t offset = static_cast<uint64_t>(m_chunks.size()) * CHUNK_BYTES;
+			m_file.Resize(offset + CHUNK_BYTES);
+			Chunk chunk;
+			chunk.m_tiles = static_cast<uint64_t*>(m_file.Map(offset, CHUNK_BYTES));
+			m_chunks.push_back(chunk);
+		}
+		slot = m_nextSlot++;
+		m_slotKeys.emplace_back(0, 0);
+		m_slotUsed.push_back(false);
+	}
+	m_slotKeys[slot] = TileKey(row >> TILE_SHIFT, col >> TILE_SHIFT);
+	m_slotUsed[slot] = true;
+
+	// Free slots are zeroed on release and new file space reads as zero
+	TileInfo info;
+	info.m_slot = slot;
+	return m_index.emplace(TileKey(row >> TILE_SHIFT, col >> TILE_SHIFT), info).first;
+}
+
+/// <summary>
+/// Return an empty tile's slot to the free list
+/// </summary>
+/// <param name="it"></param>
+void TilePageStore::ReleaseTile(Index::iterator it)
+{
+	std::memset(Tile(it->second.m_slot), 0, TILE_BYTES);
+	m_slotUsed[it->second.m_slot] = false;
+	m_freeSlots.push_back(it->second.m_slot);
+	m_index.erase(it);
+}
+
+/// <summary>
+/// Remove all cells. The file keeps its size and all slots become free.
+/// </summary>
+void TilePageStore::Clear()
+{
+	for (auto& entry : m_index)
+		std::memset(Tile(entry.second.m_slot), 0, TILE_BYTES);
+	m_index.clear();
+	m_slotUsed.assign(m_slotUsed.size(), false);
+	m_freeSlots.clear();
+	for (uint32_t slot = m_nextSlot; slot > 0; --slot)
+		m_freeSlots.push_back(slot - 1);
+	m_size = 0;
+}
+
+/// <summary>
+/// Check a cell
+/// </summary>
+/// <param name="row"></param>
+/// <param name="col"></param>
+/// <returns></returns>
+bool TilePageStore::IsSet(int64_t row, int64_t col) const
+{
+	auto it = m_index.find(TileKey(row >> TILE_SHIFT, col >> TILE_SHIFT));
+	if (it == m_index.end())
+		return false;
+	const uint64_t* tile = Tile(it->second.m_slot);
+	return (tile[row & TILE_MASK] >> (col & TILE_MASK)) & 1;
+}
+
+/// <summary>
+/// Set a cell
+/// </summary>
+/// <param name="row"></param>
+/// <param name="col"></param>
+void TilePageStore::Set(int64_t row, int64_t col)
+{
+	Index::iterator it;
+	uint64_t* tile = FindTile(row, col, it);
+	if (tile == nullptr)
+	{
+		it = CreateTile(row, col);
+		tile = Tile(it->second.m_slot);
+	}
+	uint64_t bit = 1ULL << (col & TILE_MASK);
+	uint64_t& word = tile[row & TILE_MASK];
+	if (word & bit)
+		return;
+	word |= bit;
+	++it->second.m_population;
+	++m_size;
+}
+
+/// <summary>
+/// Clear a cell
+/// </summary>
+/// <param name="row"></param>
+/// <param name="col"></param>
+void TilePageStore::Clear(int64_t row, int64_t col)
+{
+	Index::iterator it;
+	uint64_t* tile = FindTile(row, col, it);
+	if (tile == nullptr)
+		return;
+	uint64_t bit = 1ULL << (col & TILE_MASK);
+	uint64_t& word = tile[row & TILE_MASK];
+	if (!(word & bit))
+		return;
+	word &= ~bit;
+	--m_size;
+	if (--it->second.m_population == 0)
+		ReleaseTile(it);
+}
+
+/// <summary>
+/// Toggle a cell
+/// </summary>
+/// <param name="row"></param>
+/// <param name="col"></param>
+void TilePageStore::Toggle(int64_t row, int64_t col)
+{
+	if (IsSet(row, col))
+		Clear(row, col);
+	else
+		Set(row, col);
+}
+
+/// <summary>
+/// Visit all set cells. Tiles are walked in slot order, so the pass goes
+/// through the file chunk by chunk and each chunk is mapped in about once
+/// </summary>
+/// <param name="visitor"></param>
+void TilePageStore::Accept(BoardState::Visitor* visitor)
+{
+	if (visitor == nullptr)
+		throw std::invalid_argument("visitor cannot be null");
+
+	for (uint32_t slot = 0; slot < m_nextSlot; ++slot)
+	{
+		if (!m_slotUsed[slot])
+			continue;
+		const uint64_t* tile = Tile(slot);
+		const TileKey& key = m_slotKeys[slot];
+		int64_t top = static_cast<int64_t>(static_cast<uint64_t>(key.m_row) << TILE_SHIFT);
+		int64_t left = static_cast<int64_t>(static_cast<uint64_t>(key.m_col) << TILE_SHIFT);
+		for (int64_t r = 0; r < TILE_SIZE; ++r)
+		{
+			for (uint64_t bits = tile[r]; bits != 0; bits &= bits - 1)
+			{
+				if (!visitor->Visit(top + r, left + LowestBit(bits)))
+					return;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Write back and drop all resident chunks, they are mapped in again on use
+/// </summary>
+/// <returns></returns>
+size_t TilePageStore::EvictAll()
+{
+	size_t evicted = m_resident;
+	while (m_oldest != NO_CHUNK)
+		EvictOldest();
+	return evicted;
+}
+
+/// <summary>
+/// Heap memory of the tile index and slot table plus the resident tile chunks
+/// </summary>
+/// <returns></returns>
+MemoryUsage TilePageStore::GetMemoryUsage() const
+{
+	MemoryUsage usage;
+	usage.AddBlocks(m_resident, CHUNK_BYTES, m_resident * CHUNK_BYTES);
+	usage.AddBlocks(1, m_slotKeys.capacity() * sizeof(TileKey) + m_slotUsed.capacity() / 8, 0);
+	// Hash nodes plus the bucket array
+	usage.AddBlocks(m_index.size(), sizeof(void*) + sizeof(Index::value_type), m_index.size() * sizeof(Index::value_type));
+	usage.AddBlocks(1, m_index.bucket_count() * sizeof(void*), 0);
+	usage.AddBlocks(1, m_chunks.capacity() * sizeof(Chunk) + m_freeSlots.capacity() * sizeof(uint32_t), 0);
+	return usage;
+}
+
+/// <summary>
+/// Size of the backing file
+/// </summary>
+/// <returns></returns>
+uint64_t TilePageStore::FileBytes() const
+{
+	return m_file.Size();
+}
+
+/// <summary>
+/// Number of mapped in chunks
+/// </summary>
+/// <returns></returns>
+size_t TilePageStore::ResidentChunks() const
+{
+	return m_resident;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BoardState.h"
+#include "MappedFile.h"
+
+/// <summary>
+/// Cell storage for boards larger than memory. Cells are kept in 64x64 bit
+/// tiles that live in a memory mapped file; only the tile index stays on the
+/// heap. At most a budget of chunks is resident; mapping in another one
+/// writes back and drops the least recently used, so boards larger than the
+/// budget cost disk space rather than memory. Traversals walk the tiles in
+/// file order, so chunks visited earlier in a pass are the ones dropped.
+/// </summary>
+class TilePageStore
+{
+	public:
+
+		static const int TILE_SHIFT = 6;
+		static const int64_t TILE_SIZE = 1 << TILE_SHIFT;
+		static const int64_t TILE_MASK = TILE_SIZE - 1;
+
+	private:
+
+		static const size_t TILE_BYTES = TILE_SIZE * sizeof(uint64_t);
+		static const size_t CHUNK_BYTES = 1 << 20;				// File is grown and mapped in chunks
+		static const size_t CHUNK_TILES = CHUNK_BYTES / TILE_BYTES;
+
+	public:
+
+		static const size_t DEFAULT_RESIDENT_BYTES = 64 * CHUNK_BYTES;
+
+	private:
+
+		struct TileKey
+		{
+			int64_t m_row = 0;
+			int64_t m_col = 0;
+
+			TileKey(int64_t r, int64_t c) : m_row(r), m_col(c) {}
+			bool operator==(const TileKey& other) const { return m_row == other.m_row && m_col == other.m_col; }
+		};
+
+		struct TileKeyHash
+		{
+			size_t operator()(const TileKey& key) const { return static_cast<size_t>(BoardState::HashCell(key.m_row, key.m_col)); }
+		};
+
+		struct TileInfo
+		{
+			uint32_t m_slot = 0;
+			uint32_t m_population = 0;
+		};
+
+		static const uint32_t NO_CHUNK = UINT32_MAX;
+
+		// Resident chunks are linked most recently used first, by index as m_chunks grows
+		struct Chunk
+		{
+			uint64_t* m_tiles = nullptr;
+			uint32_t m_newer = NO_CHUNK;
+			uint32_t m_older = NO_CHUNK;
+			bool m_resident = false;
+		};
+
+		typedef std::unordered_map<TileKey, TileInfo, TileKeyHash> Index;
+
+		MappedFile m_file;
+		Index m_index;
+		mutable std::vector<Chunk> m_chunks;	// Usage is tracked on reads too
+		mutable size_t m_resident = 0;			// Chunks with m_resident set
+		mutable uint32_t m_newest = NO_CHUNK;	// Ends of the resident list
+		mutable uint32_t m_oldest = NO_CHUNK;
+		size_t m_maxResident;
+		std::vector<TileKey> m_slotKeys;		// Tile of every slot below m_nextSlot
+		std::vector<bool> m_slotUsed;
+		std::vector<uint32_t> m_freeSlots;
+		uint32_t m_nextSlot = 0;
+		size_t m_size = 0;
+
+		uint64_t* Tile(uint32_t slot) const;
+		void Unlink(uint32_t index) const;
+		void EvictOldest() const;
+		uint64_t* FindTile(int64_t row, int64_t col, Index::iterator& it);
+		Index::iterator CreateTile(int64_t row, int64_t col);
+		void ReleaseTile(Index::iterator it);
+
+	public:
+
+		// path: scratch file backing the tiles, removed again when the store is destroyed
+		// residentBytes: memory for mapped in tiles, at least one chunk is always resident
+		TilePageStore(const std::string& path, size_t residentBytes = DEFAULT_RESIDENT_BYTES);
+		TilePageStore(const TilePageStore&) = delete;
+		TilePageStore& operator=(const TilePageStore&) = delete;
+		virtual ~TilePageStore();
+
+		inline size_t Size() const
+		{
+			return m_size;
+		}
+
+		inline size_t Tiles() const
+		{
+			return m_index.size();
+		}
+
+		void Clear();
+		bool IsSet(int64_t row, int64_t col) const;
+		void Set(int64_t row, int64_t col);
+		void Clear(int64_t row, int64_t col);
+		void Toggle(int64_t row, int64_t col);
+
+		// Visit all set cells, tile by tile in file order
+		void Accept(BoardState::Visitor* visitor);
+
+		// Write back and drop all resident chunks, returns number of evicted chunks
+		size_t EvictAll();
+
+		MemoryUsage GetMemoryUsage() const;
+		uint64_t FileBytes() const;
+		size_t ResidentChunks() const;
+};
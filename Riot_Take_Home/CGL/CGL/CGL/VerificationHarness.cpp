@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "FlatCellSet.h"
+#include "VerificationHarness.h"
+
+namespace
+{
+	const int64_t MAX = std::numeric_limits<int64_t>::max();
+	const int64_t MIN = std::numeric_limits<int64_t>::min();
+
+	/// <summary>
+	/// Collects the live cells of a board
+	/// </summary>
+	class CellCollector : public Board::Visitor
+	{
+		public:
+
+			Pattern m_cells;
+
+			virtual bool Visit(Board& board, int64_t row, int64_t col)
+			{
+				m_cells.emplace_back(row, col);
+				return true;
+			}
+	};
+
+	bool Less(const BoardState::Cell& a, const BoardState::Cell& b)
+	{
+		return a.m_row < b.m_row || (a.m_row == b.m_row && a.m_col < b.m_col);
+	}
+
+	Pattern SortedCells(Board& board)
+	{
+		CellCollector collector;
+		board.Accept(&collector);
+		std::sort(collector.m_cells.begin(), collector.m_cells.end(), Less);
+		return collector.m_cells;
+	}
+
+	/// <summary>
+	/// Pattern drawn with '*' for live cells, placed with its top left corner at (row, col).
+	/// Direction signs flip it so spaceships can be aimed at any corner
+	/// </summary>
+	Pattern Draw(const std::vector<const char*>& rows, int64_t row, int64_t col, int rowSign = 1, int colSign = 1)
+	{
+		Pattern cells;
+		for (size_t r = 0; r < rows.size(); ++r)
+			for (size_t c = 0; rows[r][c] != '\0'; ++c)
+				if (rows[r][c] == '*')
+					cells.emplace_back(row + rowSign * (int64_t)r, col + colSign * (int64_t)c);
+		return cells;
+	}
+
+	void Append(Pattern& to, const Pattern& from)
+	{
+		to.insert(to.end(), from.begin(), from.end());
+	}
+
+	/// <summary>
+	/// Random soup of the given density in a size x size box starting at (row, col)
+	/// </summary>
+	Pattern Soup(std::mt19937_64& random, int64_t row, int64_t col, int64_t size, double density)
+	{
+		std::bernoulli_distribution alive(density);
+		Pattern cells;
+		for (int64_t r = 0; r < size; ++r)
+			for (int64_t c = 0; c < size; ++c)
+				if (alive(random))
+					cells.emplace_back(row + r, col + c);
+		return cells;
+	}
+
+	double Seconds(std::chrono::steady_clock::duration d)
+	{
+		return std::chrono::duration<double>(d).count();
+	}
+}
+
+/// <summary>
+/// ctor
+/// </summary>
+/// <param name="reference">:creates the trusted engine</param>
+/// <param name="candidate">:creates the engine under test</param>
+/// <param name="generations">:generations to compare per case</param>
+VerificationHarness::VerificationHarness(EngineFactory reference, EngineFactory candidate, size_t generations)
+	: m_reference(reference), m_candidate(candidate), m_generations(generations)
+{
+	if (!m_reference || !m_candidate)
+		throw std::invalid_argument("Verification needs a reference and a candidate engine");
+}
+
+/// <summary>
+/// Standard case set
+/// </summary>
+/// <param name="soups">:random soups at each placement</param>
+/// <param name="seed">:random seed, the same seed gives the same cases</param>
+/// <returns></returns>
+std::vector<VerificationHarness::Case> VerificationHarness::StandardCases(size_t soups, uint64_t seed)
+{
+	const std::vector<const char*> glider = { ".*.", "..*", "***" };
+	const std::vector<const char*> lwss = { ".*..*", "*....", "*...*", "****." };
+	const std::vector<const char*> blinker = { "***" };
+	const std::vector<const char*> rPentomino = { ".**", "**.", ".*." };
+
+	std::vector<Case> cases;
+	cases.push_back({ "glider", Draw(glider, 0, 0) });
+	cases.push_back({ "lwss", Draw(lwss, 0, 0) });
+	cases.push_back({ "r-pentomino", Draw(rPentomino, 0, 0) });
+
+	// The shape of testData_01.txt: small clusters trillions of cells apart
+	Case far = { "far clusters", Draw(glider, 0, 0) };
+	Append(far.m_cells, Draw(blinker, -2000000000000, -2000000000000));
+	Append(far.m_cells, Draw(rPentomino, 2000000000000, -5));
+	cases.push_back(far);
+
+	// Across the 32 bit boundaries of the BoardState trie
+	cases.push_back({ "trie boundary", Draw(rPentomino, 0xFFFFFFFFLL - 1, -2) });
+
+	// Gliders flying in to each corner of the plane, and blinkers cut by the edges
+	cases.push_back({ "glider to MAX,MAX", Draw(glider, MAX - 12, MAX - 12) });
+	cases.push_back({ "glider to MIN,MIN", Draw(glider, MIN + 12, MIN + 12, -1, -1) });
+	cases.push_back({ "glider to MIN,MAX", Draw(glider, MIN + 12, MAX - 12, -1, 1) });
+	cases.push_back({ "glider to MAX,MIN", Draw(glider, MAX - 12, MIN + 12, 1, -1) });
+	Case edges = { "blinkers on edges", Draw(blinker, MAX, 0) };
+	Append(edges.m_cells, Draw(blinker, MIN, 0));
+	Append(edges.m_cells, Draw({ "*", "*", "*" }, 0, MAX));
+	Append(edges.m_cells, Draw({ "*", "*", "*" }, 0, MIN));
+	Append(edges.m_cells, Draw(blinker, MAX, MAX - 2));
+	cases.push_back(edges);
+
+	// Soups in the middle and pressed in to the corners of the plane
+	std::mt19937_64 random(seed);
+	const int64_t size = 32;
+	const struct { const char* m_name; int64_t m_row; int64_t m_col; } places[] =
+	{
+		{ "origin", -size / 2, -size / 2 },
+		{ "MIN,MIN", MIN, MIN },
+		{ "MAX,MAX", MAX - size + 1, MAX - size + 1 },
+		{ "MIN,MAX", MIN, MAX - size + 1 },
+		{ "MAX,MIN", MAX - size + 1, MIN },
+	};
+	for (size_t i = 0; i < soups; ++i)
+	{
+		for (const auto& place : places)
+		{
+			double density = 0.15 + 0.6 * (double)i / (double)std::max<size_t>(1, soups);
+			cases.push_back({ std::string("soup ") + std::to_string(i) + " at " + place.m_name,
+				Soup(random, place.m_row, place.m_col, size, density) });
+		}
+	}
+	return cases;
+}
+
+/// <summary>
+/// Find the smallest cell whose state differs between the two boards
+/// </summary>
+/// <param name="reference"></param>
+/// <param name="candidate"></param>
+/// <param name="result"></param>
+void VerificationHarness::FirstDifference(Board& reference, Board& candidate, Result& result)
+{
+	Pattern expected = SortedCells(reference);
+	Pattern actual = SortedCells(candidate);
+	size_t i = 0;
+	while (i < expected.size() && i < actual.size()
+		&& expected[i].m_row == actual[i].m_row && expected[i].m_col == actual[i].m_col)
+		++i;
+
+	bool fromReference = i < expected.size() && (i >= actual.size() || Less(expected[i], actual[i]));
+	const BoardState::Cell& cell = fromReference ? expected[i] : actual[i];
+	result.m_row = cell.m_row;
+	result.m_col = cell.m_col;
+	result.m_referenceAlive = fromReference;
+}
+
+/// <summary>
+/// Step one case on both engines and compare every generation
+/// </summary>
+/// <param name="testCase"></param>
+/// <returns></returns>
+VerificationHarness::Result VerificationHarness::Verify(const Case& testCase)
+{
+	Result result;
+	result.m_name = testCase.m_name;
+
+	Board reference;
+	Board candidate;
+	for (const auto& cell : testCase.m_cells)
+	{
+		reference.Initialize(cell.m_row, cell.m_col);
+		candidate.Initialize(cell.m_row, cell.m_col);
+	}
+	std::unique_ptr<Board::Visitor> referenceEngine = m_reference();
+	std::unique_ptr<Board::Visitor> candidateEngine = m_candidate();
+
+	for (size_t gen = 0; gen <= m_generations; ++gen)
+	{
+		result.m_generations = gen;
+		if (reference.Size() != candidate.Size() || reference.Hash() != candidate.Hash())
+		{
+			result.m_passed = false;
+			result.m_divergedAt = gen;
+			FirstDifference(reference, candidate, result);
+			break;
+		}
+		if (gen == m_generations)
+			break;
+
+		auto start = std::chrono::steady_clock::now();
+		reference.Accept(referenceEngine.get());
+		auto middle = std::chrono::steady_clock::now();
+		candidate.Accept(candidateEngine.get());
+		auto end = std::chrono::steady_clock::now();
+		result.m_referenceSeconds += Seconds(middle - start);
+		result.m_candidateSeconds += Seconds(end - middle);
+	}
+	return result;
+}
+
+/// <summary>
+/// Insert cells around the origin and the INT64 edges in to a set that starts
+/// at minimal size, so it rehashes several times, then look each cell up
+/// </summary>
+/// <param name="seed"></param>
+/// <returns>failed with the first cell that was lost or stored twice</returns>
+VerificationHarness::Result VerificationHarness::VerifyCellSet(uint64_t seed)
+{
+	Result result;
+	result.m_name = "flat cell set growth";
+
+	std::mt19937_64 random(seed);
+	Pattern cells = Soup(random, -32, -32, 64, 0.5);
+	Append(cells, Soup(random, MIN, MIN, 16, 0.5));
+	Append(cells, Soup(random, MAX - 15, MAX - 15, 16, 0.5));
+	std::vector<int64_t> rows, cols;
+	for (const auto& cell : cells)
+	{
+		rows.push_back(cell.m_row);
+		cols.push_back(cell.m_col);
+	}
+	std::vector<uint64_t> hashes(cells.size());
+
+	auto start = std::chrono::steady_clock::now();
+	FlatCellSet::HashBatch(rows.data(), cols.data(), hashes.data(), cells.size());
+	FlatCellSet set;
+	for (size_t i = 0; i < cells.size(); ++i)
+		set.Insert(hashes[i], rows[i], cols[i]);
+	for (size_t i = 0; i < cells.size() && result.m_passed; ++i)
+	{
+		if (hashes[i] != FlatCellSet::Hash(rows[i], cols[i]) || !set.Contains(hashes[i], rows[i], cols[i])
+			|| set.Insert(hashes[i], rows[i], cols[i]))
+		{
+			result.m_passed = false;
+			result.m_row = rows[i];
+			result.m_col = cols[i];
+			result.m_referenceAlive = true;
+		}
+	}
+	if (result.m_passed && set.Size() != cells.size())
+		result.m_passed = false;
+	result.m_candidateSeconds = Seconds(std::chrono::steady_clock::now() - start);
+	return result;
+}
+
+/// <summary>
+/// Write a run as a diff stream, read it back on to an empty board and compare
+/// that board with the stepped one at every generation
+/// </summary>
+/// <param name="format"></param>
+/// <param name="seed"></param>
+/// <returns>failed with the generation whose replay differs</returns>
+VerificationHarness::Result VerificationHarness::VerifyDiffStream(DiffWriter::Format format, uint64_t seed)
+{
+	Result result;
+	result.m_name = format == DiffWriter::Format::Text ? "diff stream text" : "diff stream binary";
+
+	std::mt19937_64 random(seed);
+	Board board;
+	for (const auto& cell : Soup(random, -16, -16, 32, 0.4))
+		board.Initialize(cell.m_row, cell.m_col);
+
+	std::stringstream stream;
+	DiffWriter writer(stream, format);
+	board.AddToggleObserver(&writer);
+	writer.WriteInitial(board);
+	std::vector<uint64_t> hashes(1, board.Hash());
+	std::unique_ptr<Board::Visitor> engine = m_candidate();
+	auto start = std::chrono::steady_clock::now();
+	for (size_t gen = 0; gen < m_generations; ++gen)
+	{
+		board.Accept(engine.get());
+		hashes.push_back(board.Hash());
+	}
+	result.m_candidateSeconds = Seconds(std::chrono::steady_clock::now() - start);
+	board.RemoveToggleObserver(&writer);
+
+	DiffReader reader(stream);
+	Board replay;
+	uint64_t generation = 0;
+	Pattern births, deaths;
+	size_t records = 0;
+	while (result.m_passed && reader.Read(generation, births, deaths))
+	{
+		for (const auto& cell : births)
+			replay.QueueToggle(cell.m_row, cell.m_col);
+		for (const auto& cell : deaths)
+			replay.QueueToggle(cell.m_row, cell.m_col);
+		replay.ApplyToggles();
+		result.m_generations = records;
+		if (generation != records || records >= hashes.size() || replay.Hash() != hashes[records])
+		{
+			result.m_passed = false;
+			result.m_divergedAt = records;
+		}
+		++records;
+	}
+	if (result.m_passed && records != hashes.size())
+	{
+		result.m_passed = false;
+		result.m_divergedAt = records;
+	}
+	return result;
+}
+
+/// <summary>
+/// Verify all cases
+/// </summary>
+/// <param name="cases"></param>
+/// <returns>one result per case</returns>
+std::vector<VerificationHarness::Result> VerificationHarness::Run(const std::vector<Case>& cases)
+{
+	std::vector<Result> results;
+	results.reserve(cases.size());
+	for (const auto& testCase : cases)
+		results.push_back(Verify(testCase));
+	return results;
+}
+
+/// <summary>
+/// Print results
+/// </summary>
+/// <param name="out"></param>
+/// <param name="results"></param>
+/// <returns>true if all cases passed</returns>
+bool VerificationHarness::Print(std::ostream& out, const std::vector<Result>& results)
+{
+	size_t failed = 0;
+	double referenceSeconds = 0;
+	double candidateSeconds = 0;
+	for (const auto& result : results)
+	{
+		referenceSeconds += result.m_referenceSeconds;
+		candidateSeconds += result.m_candidateSeconds;
+		out << (result.m_passed ? "PASS " : "FAIL ") << result.m_name
+			<< std::fixed << std::setprecision(6)
+			<< " reference " << result.m_referenceSeconds << "s candidate " << result.m_candidateSeconds << 's';
+		if (!result.m_passed)
+		{
+			++failed;
+			out << " diverged at generation " << result.m_divergedAt
+				<< ": cell " << result.m_row << ' ' << result.m_col
+				<< (result.m_referenceAlive ? " alive in reference only" : " alive in candidate only");
+		}
+		out << '\n';
+	}
+
+	out << results.size() - failed << '/' << results.size() << " passed"
+		<< std::fixed << std::setprecision(6)
+		<< ", reference " << referenceSeconds << "s candidate " << candidateSeconds << 's';
+	if (candidateSeconds > 0)
+		out << std::setprecision(2) << " (" << referenceSeconds / candidateSeconds << "x)";
+	out << '\n';
+	return failed == 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Board.h"
+#include "DiffStream.h"
+#include "LifeIO.h"
+
+/// <summary>
+/// Differential verification of a candidate update engine against a reference.
+/// Both engines step their own copy of each test case in lockstep; board hashes
+/// are compared every generation and the first divergent cell is reported.
+/// Both engines are timed so a speedup comes with its correctness check.
+/// </summary>
+class VerificationHarness
+{
+	public:
+
+		typedef std::function<std::unique_ptr<Board::Visitor>()> EngineFactory;
+
+		/// <summary>
+		/// Named starting pattern
+		/// </summary>
+		struct Case
+		{
+			std::string m_name;
+			Pattern m_cells;
+		};
+
+		/// <summary>
+		/// Outcome of one case
+		/// </summary>
+		struct Result
+		{
+			std::string m_name;
+			bool m_passed = true;
+			size_t m_generations = 0;		// Generations compared
+			// First divergence, valid if not passed
+			size_t m_divergedAt = 0;
+			int64_t m_row = 0;
+			int64_t m_col = 0;
+			bool m_referenceAlive = false;
+			double m_referenceSeconds = 0;
+			double m_candidateSeconds = 0;
+		};
+
+	private:
+
+		EngineFactory m_reference;
+		EngineFactory m_candidate;
+		size_t m_generations = 0;
+
+		static void FirstDifference(Board& reference, Board& candidate, Result& result);
+
+	public:
+
+		VerificationHarness(EngineFactory reference, EngineFactory candidate, size_t generations);
+
+		// Random soups, known patterns and patterns against the INT64 edges of the plane
+		static std::vector<Case> StandardCases(size_t soups, uint64_t seed);
+
+		Result Verify(const Case& testCase);
+		// Grow a FlatCellSet from its minimal size and look every cell up again, reported like a case
+		static Result VerifyCellSet(uint64_t seed);
+		// Step a soup on the candidate with a DiffWriter attached and replay the stream read back by DiffReader
+		Result VerifyDiffStream(DiffWriter::Format format, uint64_t seed);
+		std::vector<Result> Run(const std::vector<Case>& cases);
+
+		// Print one line per case and the totals. Returns true if all cases passed
+		static bool Print(std::ostream& out, const std::vector<Result>& results);
+};